@@ -0,0 +1,258 @@
+﻿#ifndef CONCURRENTORDEREDQMAP_H
+#define CONCURRENTORDEREDQMAP_H
+#include "OrderedQMap.h"
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QVector>
+#include <QDataStream>
+#include <algorithm>
+
+/**
+* \brief template ConcurrentOrderedQMap class is an insertion ordered map that many threads can write at once
+*
+* Keys are spread over Stripes independently locked hashes, so writers of different keys rarely wait for
+* each other. The insertion order is a global sequence number taken from an atomic counter when a key is added;
+* replacing the value of a present key keeps its position.
+* Every stripe sits on its own cache line, including its share of size(); a map allocated with new needs
+* C++17 for that alignment. benchmarks/bench_concurrent.cpp measures the scaling with the writer count.
+* toOrderedQMap() (and everything built on it) locks all stripes for reading at once, so it exports a
+* consistent state: every insert that finished before is in it, in sequence order.
+*
+* \code
+* ConcurrentOrderedQMap<QString, QVariant> registry;
+*
+* //any number of threads
+* registry.insert(event.id(), event.payload());
+*
+* //consumer
+* QVariantOrderedQMap ordered = registry.toOrderedQMap();
+* \endcode
+*/
+
+namespace ActionNet {
+
+    template <class Key, class T, int Stripes = 16> class ConcurrentOrderedQMap
+    {
+        static_assert(Stripes > 0, "ConcurrentOrderedQMap needs at least one stripe");
+
+    public:
+        ConcurrentOrderedQMap() : m_sequence(0) {}
+
+        //inserts or replaces the value of key; returns true when key was new
+        bool insert(const Key & key, const T & value)
+        {
+          Stripe & s = stripe(key);
+          QWriteLocker locker(&s.lock);
+          typename QHash<Key, Entry>::iterator it = s.entries.find(key);
+          if (it != s.entries.end())
+          {
+            it.value().value = value;
+            return false;
+          }
+          Entry e = { m_sequence.fetchAndAddOrdered(1), value };
+          s.entries.insert(key, e);
+          s.size.storeRelease(s.entries.size());
+          return true;
+        }
+
+        //inserts key only when it is not present; returns true when it was inserted
+        bool insertIfAbsent(const Key & key, const T & value)
+        {
+          Stripe & s = stripe(key);
+          QWriteLocker locker(&s.lock);
+          if (s.entries.contains(key))
+            return false;
+          Entry e = { m_sequence.fetchAndAddOrdered(1), value };
+          s.entries.insert(key, e);
+          s.size.storeRelease(s.entries.size());
+          return true;
+        }
+
+        bool remove(const Key & key)
+        {
+          Stripe & s = stripe(key);
+          QWriteLocker locker(&s.lock);
+          if (!s.entries.remove(key))
+            return false;
+          s.size.storeRelease(s.entries.size());
+          return true;
+        }
+
+        bool contains(const Key & key) const
+        {
+          const Stripe & s = stripe(key);
+          QReadLocker locker(&s.lock);
+          return s.entries.contains(key);
+        }
+
+        T value(const Key & key, const T & defaultValue = T()) const
+        {
+          const Stripe & s = stripe(key);
+          QReadLocker locker(&s.lock);
+          typename QHash<Key, Entry>::const_iterator it = s.entries.constFind(key);
+          return it == s.entries.constEnd() ? defaultValue : it.value().value;
+        }
+
+        //sum of the stripe sizes, so writers never share a counter; exact when no writer is running,
+        //otherwise a recent value
+        int size() const
+        {
+          int n = 0;
+          for (int i = 0; i < Stripes; ++i)
+            n += m_stripes[i].size.loadAcquire();
+          return n;
+        }
+
+        int count() const { return size(); }
+
+        bool isEmpty() const { return size() == 0; }
+
+        void clear()
+        {
+          for (int i = 0; i < Stripes; ++i)
+            m_stripes[i].lock.lockForWrite();
+          for (int i = 0; i < Stripes; ++i)
+          {
+            m_stripes[i].entries.clear();
+            m_stripes[i].size.storeRelease(0);
+          }
+          for (int i = Stripes - 1; i >= 0; --i)
+            m_stripes[i].lock.unlock();
+        }
+
+        //consistent copy of all entries in insertion order
+        OrderedQMap<Key, T> toOrderedQMap() const
+        {
+          Rows rows;
+          orderedRows(rows);
+          OrderedQMap<Key, T> map;
+          map.reserve(rows.rows.size());
+          for (const Row & r : rows.rows)
+            map.insert(*r.key, r.entry->value);
+          return map;
+        }
+
+        QList<Key> keys() const
+        {
+          Rows rows;
+          orderedRows(rows);
+          QList<Key> res;
+          res.reserve(rows.rows.size());
+          for (const Row & r : rows.rows)
+            res.append(*r.key);
+          return res;
+        }
+
+        QList<T> values() const
+        {
+          Rows rows;
+          orderedRows(rows);
+          QList<T> res;
+          res.reserve(rows.rows.size());
+          for (const Row & r : rows.rows)
+            res.append(r.entry->value);
+          return res;
+        }
+
+        //calls f(key, value) for a consistent copy of the entries in insertion order, without holding any lock
+        template <class Function> void forEachOrdered(Function f) const
+        {
+          Rows rows;
+          orderedRows(rows);
+          for (const Row & r : rows.rows)
+            f(*r.key, r.entry->value);
+        }
+
+        //writes the same format as OrderedQMap
+        friend QDataStream &operator <<(QDataStream &out, const ConcurrentOrderedQMap &obj)
+        {
+          Rows rows;
+          obj.orderedRows(rows);
+          OrderedQMapStream::writeHeader(out, rows.rows.size());
+          for (const Row & r : rows.rows)
+            out << *r.key << r.entry->value;
+          return out;
+        }
+
+        friend QDataStream &operator >>(QDataStream &in, ConcurrentOrderedQMap &obj)
+        {
+          OrderedQMap<Key, T> map;
+          in >> map;
+          for (typename OrderedQMap<Key, T>::const_ordered_iterator it = map.constOrderedBegin(); it != map.constOrderedEnd(); ++it)
+            obj.insert(it.key(), it.value());
+          return in;
+        }
+
+    private:
+        Q_DISABLE_COPY(ConcurrentOrderedQMap)
+
+        struct Entry
+        {
+          qint64 sequence;
+          T value;
+        };
+
+        //on a cache line of its own, so writers of neighbouring stripes do not contend for one
+        struct alignas(64) Stripe
+        {
+          mutable QReadWriteLock lock;
+          QHash<Key, Entry> entries;
+          QAtomicInt size;    //entries.size(), written under lock and read by size() without it
+        };
+
+        struct Row
+        {
+          qint64 sequence;
+          const Key * key;
+          const Entry * entry;
+
+          bool operator<(const Row & o) const { return sequence < o.sequence; }
+        };
+
+        //rows point into the shallow stripe copies kept alongside them
+        struct Rows
+        {
+          QHash<Key, Entry> stripes[Stripes];
+          QVector<Row> rows;
+        };
+
+        Stripe m_stripes[Stripes];
+        QAtomicInteger<qint64> m_sequence;
+
+        Stripe & stripe(const Key & key) { return m_stripes[qHash(key) % uint(Stripes)]; }
+
+        const Stripe & stripe(const Key & key) const { return m_stripes[qHash(key) % uint(Stripes)]; }
+
+        //locks every stripe for reading (always in the same order, so exports cannot deadlock each other),
+        //takes shallow copies of the hashes and sorts by sequence after unlocking
+        void orderedRows(Rows & res) const
+        {
+          for (int i = 0; i < Stripes; ++i)
+            m_stripes[i].lock.lockForRead();
+          int total = 0;
+          for (int i = 0; i < Stripes; ++i)
+          {
+            res.stripes[i] = m_stripes[i].entries;
+            total += res.stripes[i].size();
+          }
+          for (int i = Stripes - 1; i >= 0; --i)
+            m_stripes[i].lock.unlock();
+
+          res.rows.reserve(total);
+          for (int i = 0; i < Stripes; ++i)
+            for (typename QHash<Key, Entry>::const_iterator it = res.stripes[i].constBegin(); it != res.stripes[i].constEnd(); ++it)
+            {
+              Row r = { it.value().sequence, &it.key(), &it.value() };
+              res.rows.append(r);
+            }
+          std::sort(res.rows.begin(), res.rows.end());
+        }
+    };
+
+}
+
+#endif // CONCURRENTORDEREDQMAP_H
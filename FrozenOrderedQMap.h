@@ -0,0 +1,393 @@
+﻿#ifndef FROZENORDEREDQMAP_H
+#define FROZENORDEREDQMAP_H
+#include "OrderedQMap.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+/**
+* \brief template FrozenOrderedQMap class is a read-only ordered map with QString keys that is used straight
+* from a memory mapped file
+*
+* write() stores an OrderedQMap (or CompactOrderedQMap) once as a flat file: a table of the entries in
+* insertion order, an open addressing hash index over them and a pool holding the UTF-16 keys and the
+* QDataStream encoded values. open() maps the file and only checks the header and that the tables lie
+* inside it, nothing is parsed or allocated, so opening is O(1) for any size. Every entry is checked when
+* it is read instead: one whose key or value lies outside the pool reads as an empty key and a default
+* value, and keyOrder() stops after one pass over a corrupt index.
+* key() returns a QString sharing the mapped memory; a value is decoded each time it is read.
+* The file stores numbers in the byte order of the writer, a file written on the other byte order is
+* rejected. Values must fit in a 2 GB QByteArray together with the keys while writing.
+*
+* \code
+* QVariantOrderedQMap table = loadTable();
+* FrozenOrderedQMap<QVariant>::write(table, "table.foqm");
+*
+* FrozenOrderedQMap<QVariant> frozen;
+* if (frozen.open("table.foqm")) {
+*   for (int i = 0; i < frozen.size(); ++i)
+*     qDebug() << frozen.key(i) << "=" << frozen.at(i);
+* }
+* \endcode
+*/
+
+namespace ActionNet {
+
+    //file layout: header, entries[count], buckets[buckets], pool
+    struct FrozenOrderedQMapHeader
+    {
+        quint32 magic;
+        quint32 version;
+        qint32 streamVersion;   //QDataStream version the values were written with
+        quint32 count;
+        quint32 buckets;        //power of two, more than count
+        quint32 reserved;
+        quint64 entriesOffset;
+        quint64 bucketsOffset;
+        quint64 poolOffset;
+        quint64 poolSize;
+    };
+
+    struct FrozenOrderedQMapEntry
+    {
+        quint64 keyOffset;      //into the pool, 2 byte aligned
+        quint64 valueOffset;    //into the pool
+        quint32 keyLength;      //in UTF-16 code units
+        quint32 valueSize;
+        quint32 hash;
+        quint32 reserved;
+    };
+
+    template <class T> class FrozenOrderedQMap
+    {
+    public:
+        enum { Magic = 0x4d514f46, Version = 1 }; //"FOQM" in little endian
+
+        FrozenOrderedQMap() {}
+
+        ~FrozenOrderedQMap() { close(); }
+
+        //maps fileName; false when it cannot be opened or is no valid frozen map
+        bool open(const QString & fileName)
+        {
+          close();
+          m_file.setFileName(fileName);
+          if (!m_file.open(QIODevice::ReadOnly))
+            return false;
+          m_mapped = m_file.map(0, m_file.size());
+          if (!m_mapped || !attach(m_mapped, m_file.size()))
+          {
+            close();
+            return false;
+          }
+          return true;
+        }
+
+        //uses data, e.g. a resource, without copying it; it must be 8 byte aligned like QByteArray's own buffers
+        bool setData(const QByteArray & data)
+        {
+          close();
+          m_data = data;
+          if (!attach(reinterpret_cast<const uchar *>(m_data.constData()), m_data.size()))
+          {
+            close();
+            return false;
+          }
+          return true;
+        }
+
+        //invalidates every key() returned so far
+        void close()
+        {
+          m_header = nullptr;
+          m_entries = nullptr;
+          m_buckets = nullptr;
+          m_pool = nullptr;
+          if (m_mapped)
+            m_file.unmap(m_mapped);
+          m_mapped = nullptr;
+          if (m_file.isOpen())
+            m_file.close();
+          m_data.clear();
+        }
+
+        bool isOpen() const { return m_header != nullptr; }
+
+        int size() const { return m_header ? int(m_header->count) : 0; }
+
+        int count() const { return size(); }
+
+        bool isEmpty() const { return size() == 0; }
+
+        //shares the mapped memory, valid until close(); empty for an index out of range or a closed map
+        QString key(int index) const
+        {
+          if (!inRange(index))
+            return QString();
+          const FrozenOrderedQMapEntry & e = m_entries[index];
+          return isValid(e) ? QString::fromRawData(keyData(e), int(e.keyLength)) : QString();
+        }
+
+        QStringView keyView(int index) const
+        {
+          if (!inRange(index))
+            return QStringView();
+          const FrozenOrderedQMapEntry & e = m_entries[index];
+          return isValid(e) ? QStringView(keyData(e), int(e.keyLength)) : QStringView();
+        }
+
+        //the value at index decoded from the pool; T() for an index out of range or a closed map
+        T at(int index) const
+        {
+          T value;
+          if (!inRange(index))
+            return value;
+          QByteArray data = valueData(index);
+          QDataStream in(data);
+          in.setVersion(m_header->streamVersion);
+          in >> value;
+          return value;
+        }
+
+        //the encoded value at index, sharing the mapped memory
+        QByteArray valueData(int index) const
+        {
+          if (!inRange(index))
+            return QByteArray();
+          const FrozenOrderedQMapEntry & e = m_entries[index];
+          if (!isValid(e))
+            return QByteArray();
+          return QByteArray::fromRawData(reinterpret_cast<const char *>(m_pool + e.valueOffset), int(e.valueSize));
+        }
+
+        T value(int index) const { return at(index); }
+
+        T value(QStringView key, const T & defaultValue = T()) const
+        {
+          int i = keyOrder(key);
+          return i < 0 ? defaultValue : at(i);
+        }
+
+        bool contains(QStringView key) const { return keyOrder(key) >= 0; }
+
+        //one probe of the precomputed index in the common case
+        int keyOrder(QStringView key) const
+        {
+          if (isEmpty())
+            return -1;
+          const quint32 mask = m_header->buckets - 1;
+          const quint32 h = hash(key);
+          //a valid index always has an empty bucket, the bound only matters for a corrupt one
+          quint32 b = h & mask;
+          for (quint32 probes = 0; probes < m_header->buckets; ++probes, b = (b + 1) & mask)
+          {
+            const quint32 slot = m_buckets[b];
+            if (slot == 0 || slot > m_header->count)
+              return -1;
+            const FrozenOrderedQMapEntry & e = m_entries[slot - 1];
+            if (e.hash == h && isValid(e) && QStringView(keyData(e), int(e.keyLength)) == key)
+              return int(slot - 1);
+          }
+          return -1;
+        }
+
+        QList<QString> keys() const
+        {
+          QList<QString> res;
+          res.reserve(size());
+          for (int i = 0; i < size(); ++i)
+            res.append(key(i));
+          return res;
+        }
+
+        //decodes every value into an ordinary map
+        OrderedQMap<QString, T> toOrderedQMap() const
+        {
+          OrderedQMap<QString, T> res;
+          res.reserve(size());
+          for (int i = 0; i < size(); ++i)
+            res.insert(key(i), at(i));
+          return res;
+        }
+
+        //iterates in insertion order; operator* decodes the value, so it returns it by value
+        class const_ordered_iterator
+        {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef qptrdiff difference_type;
+            typedef T value_type;
+            typedef const T *pointer;
+            typedef T reference;
+
+            const_ordered_iterator() : c(nullptr), i(0) {}
+
+            QString key() const { return c->key(i); }
+            T value() const { return c->at(i); }
+            T operator*() const { return value(); }
+
+            int index() const { return i; }
+
+            bool operator==(const const_ordered_iterator &o) const { return i == o.i; }
+            bool operator!=(const const_ordered_iterator &o) const { return i != o.i; }
+            const_ordered_iterator &operator++() { ++i; return *this; }
+            const_ordered_iterator operator++(int) { const_ordered_iterator r = *this; ++i; return r; }
+            const_ordered_iterator &operator--() { --i; return *this; }
+            const_ordered_iterator operator--(int) { const_ordered_iterator r = *this; --i; return r; }
+
+        private:
+            friend class FrozenOrderedQMap;
+            const_ordered_iterator(const FrozenOrderedQMap *container, int index) : c(container), i(index) {}
+
+            const FrozenOrderedQMap *c;
+            int i;
+        };
+
+        const_ordered_iterator orderedBegin() const { return const_ordered_iterator(this, 0); }
+
+        const_ordered_iterator orderedEnd() const { return const_ordered_iterator(this, size()); }
+
+        const_ordered_iterator constOrderedBegin() const { return orderedBegin(); }
+
+        const_ordered_iterator constOrderedEnd() const { return orderedEnd(); }
+
+        OrderedQMapRange<const_ordered_iterator> ordered() const { return OrderedQMapRange<const_ordered_iterator>(orderedBegin(), orderedEnd()); }
+
+        //writes map, an OrderedQMap or CompactOrderedQMap with QString keys, in insertion order
+        template <class Map> static bool write(const Map & map, QIODevice * device)
+        {
+          const int count = map.size();
+          quint32 buckets = 2;
+          while (buckets <= quint32(count) * 2)
+            buckets <<= 1;
+          QVector<FrozenOrderedQMapEntry> entries;
+          entries.reserve(count);
+          QVector<quint32> table(int(buckets), 0);
+          QByteArray pool;
+          QDataStream out(&pool, QIODevice::WriteOnly);
+          for (typename Map::const_ordered_iterator it = map.constOrderedBegin(); it != map.constOrderedEnd(); ++it)
+          {
+            const QString & key = it.key();
+            if (out.device()->pos() % 2)
+              out.writeRawData("", 1);
+            FrozenOrderedQMapEntry e;
+            e.keyOffset = quint64(out.device()->pos());
+            e.keyLength = quint32(key.size());
+            e.hash = hash(QStringView(key));
+            e.reserved = 0;
+            out.writeRawData(reinterpret_cast<const char *>(key.utf16()), key.size() * int(sizeof(QChar)));
+            e.valueOffset = quint64(out.device()->pos());
+            out << it.value();
+            e.valueSize = quint32(quint64(out.device()->pos()) - e.valueOffset);
+            if (out.status() != QDataStream::Ok)
+              return false;
+            quint32 b = e.hash & (buckets - 1);
+            while (table.at(int(b)))
+              b = (b + 1) & (buckets - 1);
+            table[int(b)] = quint32(entries.size() + 1);
+            entries.append(e);
+          }
+
+          FrozenOrderedQMapHeader header;
+          header.magic = Magic;
+          header.version = Version;
+          header.streamVersion = out.version();
+          header.count = quint32(count);
+          header.buckets = buckets;
+          header.reserved = 0;
+          header.entriesOffset = sizeof(FrozenOrderedQMapHeader);
+          header.bucketsOffset = header.entriesOffset + quint64(count) * sizeof(FrozenOrderedQMapEntry);
+          header.poolOffset = header.bucketsOffset + quint64(buckets) * sizeof(quint32);
+          header.poolSize = quint64(pool.size());
+          return writeBlock(device, &header, sizeof(header))
+              && writeBlock(device, entries.constData(), qint64(count) * qint64(sizeof(FrozenOrderedQMapEntry)))
+              && writeBlock(device, table.constData(), qint64(buckets) * qint64(sizeof(quint32)))
+              && writeBlock(device, pool.constData(), pool.size());
+        }
+
+        template <class Map> static bool write(const Map & map, const QString & fileName)
+        {
+          QFile file(fileName);
+          if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+          return write(map, &file) && file.flush();
+        }
+
+        //FNV-1a over the UTF-16 code units; unlike qHash it does not change between runs
+        static quint32 hash(QStringView key)
+        {
+          quint32 h = 2166136261u;
+          for (int i = 0; i < key.size(); ++i)
+          {
+            const ushort u = key.at(i).unicode();
+            h = (h ^ (u & 0xff)) * 16777619u;
+            h = (h ^ (u >> 8)) * 16777619u;
+          }
+          return h;
+        }
+
+    private:
+        Q_DISABLE_COPY(FrozenOrderedQMap)
+
+        const FrozenOrderedQMapHeader * m_header = nullptr;
+        const FrozenOrderedQMapEntry * m_entries = nullptr;
+        const quint32 * m_buckets = nullptr;
+        const uchar * m_pool = nullptr;
+        QFile m_file;
+        uchar * m_mapped = nullptr;
+        QByteArray m_data;
+
+        //false for a closed map, whose size() is 0
+        bool inRange(int index) const { return index >= 0 && index < size(); }
+
+        const QChar * keyData(const FrozenOrderedQMapEntry & e) const
+        { return reinterpret_cast<const QChar *>(m_pool + e.keyOffset); }
+
+        static bool writeBlock(QIODevice * device, const void * data, qint64 size)
+        { return device->write(static_cast<const char *>(data), size) == size; }
+
+        //true when [offset, offset + length) lies within size bytes
+        static bool fits(quint64 offset, quint64 length, quint64 size)
+        { return offset <= size && length <= size - offset; }
+
+        //true when the key and the value of e lie inside the pool
+        bool isValid(const FrozenOrderedQMapEntry & e) const
+        {
+          return e.keyOffset % sizeof(QChar) == 0 && e.valueSize <= quint32(std::numeric_limits<int>::max())
+              && e.keyLength <= quint32(std::numeric_limits<int>::max())
+              && fits(e.keyOffset, quint64(e.keyLength) * sizeof(QChar), m_header->poolSize)
+              && fits(e.valueOffset, e.valueSize, m_header->poolSize);
+        }
+
+        //checks the header and that the tables lie inside data; the entries are checked as they are read
+        bool attach(const uchar * data, qint64 size)
+        {
+          const quint64 total = quint64(size);
+          if (total < sizeof(FrozenOrderedQMapHeader) || quintptr(data) % alignof(FrozenOrderedQMapEntry) != 0)
+            return false;
+          const FrozenOrderedQMapHeader * h = reinterpret_cast<const FrozenOrderedQMapHeader *>(data);
+          if (h->magic != quint32(Magic) || h->version != quint32(Version))
+            return false;
+          if (h->buckets == 0 || (h->buckets & (h->buckets - 1)) != 0 || h->buckets <= h->count || h->count > quint32(std::numeric_limits<int>::max()))
+            return false;
+          if (h->entriesOffset % alignof(FrozenOrderedQMapEntry) != 0 || h->bucketsOffset % sizeof(quint32) != 0 || h->poolOffset % sizeof(QChar) != 0)
+            return false;
+          if (!fits(h->entriesOffset, quint64(h->count) * sizeof(FrozenOrderedQMapEntry), total)
+              || !fits(h->bucketsOffset, quint64(h->buckets) * sizeof(quint32), total)
+              || !fits(h->poolOffset, h->poolSize, total))
+            return false;
+          m_header = h;
+          m_entries = reinterpret_cast<const FrozenOrderedQMapEntry *>(data + h->entriesOffset);
+          m_buckets = reinterpret_cast<const quint32 *>(data + h->bucketsOffset);
+          m_pool = data + h->poolOffset;
+          return true;
+        }
+    };
+
+}
+
+#endif // FROZENORDEREDQMAP_H
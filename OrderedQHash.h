@@ -0,0 +1,107 @@
+﻿#ifndef ORDEREDQHASH_H
+#define ORDEREDQHASH_H
+#include "OrderedQMap.h"
+#include <QHash>
+#include <QMultiHash>
+
+/**
+* \brief template OrderedQHash and OrderedQMultiHash classes provide the interface of OrderedQMap and OrderedQMultiMap
+* for keys that only have qHash() and operator==, no operator<
+*
+* OrderedQHash is a CompactOrderedQMap: the entries are kept in insertion order in one array and a single hash
+* maps every key to its slot, so a key is stored twice and a lookup by key is one hash probe.
+* OrderedQMultiHash is OrderedQMultiMap on top of a QMultiHash.
+* The insertion order, indexed access and the stream format are the same as OrderedQMap's.
+*
+* \code
+* OrderedQHash <QUuid, int> hash;
+* hash.insert(QUuid::createUuid(), 3);
+* hash.insert(QUuid::createUuid(), 2);
+*
+* for(int i = 0; i < hash.size(); ++i){
+*   qDebug() << "hash.at" << QString::number(i) << "=" << hash.at(i);
+* }
+* \endcode
+*/
+
+namespace ActionNet {
+
+    //ordered QHash: the OrderedQMap interface with O(1) lookups by key; begin()/end() iterate in
+    //insertion order, there is no separate hash order.
+    //Keys must be UNIQUE to get correct results of indexed (...at) methods
+    template <class Key, class T, class KeyPolicy = CaseSensitiveKeys> class OrderedQHash : public CompactOrderedQMap<Key, T, KeyPolicy>
+    {
+        typedef CompactOrderedQMap<Key, T, KeyPolicy> Base;
+
+    public:
+        typedef Key key_type;
+        typedef T mapped_type;
+        typedef typename Base::ordered_iterator iterator;
+        typedef typename Base::const_ordered_iterator const_iterator;
+
+        OrderedQHash() {}
+
+        //inserts the pairs in list order, like chained operator<< calls
+        OrderedQHash(std::initializer_list<QPair<Key,T> > list) : Base(list) {}
+
+        iterator begin() { return Base::orderedBegin(); }
+
+        const_iterator begin() const { return Base::orderedBegin(); }
+
+        iterator end() { return Base::orderedEnd(); }
+
+        const_iterator end() const { return Base::orderedEnd(); }
+
+        //builds a map ordered like pairs; a repeated key keeps its first position and its last value
+        static OrderedQHash fromOrderedPairs(const QList<QPair<Key,T> > & pairs)
+        {
+          OrderedQHash map;
+          map.insertRange(pairs.begin(), pairs.end());
+          return map;
+        }
+
+        QHash<Key, T> toQHash() const
+        {
+          QHash<Key, T> res;
+          res.reserve(Base::size());
+          for (const_iterator it = begin(); it != end(); ++it)
+            res.insert(it.key(), it.value());
+          return res;
+        }
+
+        //the legacy format stored a QMap and never existed for OrderedQHash, it is rejected as corrupt
+        friend QDataStream &operator >>(QDataStream &in, OrderedQHash &obj)
+        {
+          qint32 count = 0;
+          bool legacy = false;
+          if (!OrderedQMapStream::readHeader(in, count, legacy))
+            return in;
+          if (legacy)
+          {
+            in.setStatus(QDataStream::ReadCorruptData);
+            return in;
+          }
+          obj.reserve(obj.slotCount() + OrderedQMapStream::reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Key k;
+            T v;
+            in >> k >> v;
+            if (in.status() != QDataStream::Ok)
+              break;
+            obj.insert(k, std::move(v));
+          }
+          return in;
+        }
+    };
+
+    //ordered QMultiHash: the OrderedQMultiMap interface on a QMultiHash, see OrderedQMultiMap;
+    //the legacy stream format is rejected as corrupt
+    template <class Key, class T, class KeyPolicy = CaseSensitiveKeys> using OrderedQMultiHash = OrderedQMultiMap<Key, T, KeyPolicy, QMultiHash>;
+
+}
+
+typedef ActionNet::OrderedQHash<QString, QVariant> QVariantOrderedQHash;
+Q_DECLARE_METATYPE(QVariantOrderedQHash)
+
+#endif // ORDEREDQHASH_H
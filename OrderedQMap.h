@@ -1,17 +1,48 @@
 ﻿#ifndef ORDEREDQMAP_H
 #define ORDEREDQMAP_H
 #include <QMap>
+#include <QHash>
+#include <QMultiHash>
 #include <QVariant>
 #include <QList>
+#include <QVector>
+#include <QVarLengthArray>
 #include <QString>
+#include <QStringView>
 #include <QJsonArray>
 #include <QJsonValue>
 #include <QJsonDocument>
+#include <QLocale>
 #include <QDebug>
+#include <QIODevice>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//the inline index of SmallAllocation compares hashes four at a time with the SIMD instructions every
+//x86-64 and AArch64 CPU has; anything else uses the scalar loop. OrderedQMapSmallIndex::matchHashes()
+//tests the same compiler macros, so the header defines none of its own
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 /**
 * \brief template OrderedQMap and OrderedQMultiMap class provides an interface for initializable ordered QMap<Key, T> with  (data)stream operators << >>
 *
+* CompactOrderedQMap provides the same ordered interface with single storage: entries are kept in insertion order
+* in one vector and looked up through a hash index, so indexed access does not need a second lookup.
+*
 * \code
 * OrderedQMap <QString, int> map;
 * map.insert("3",3);
@@ -44,6 +75,9 @@
 *        << QPair<QString, int>("Saturday", 7)
 * * \endcode
 *
+* Such a map is built at static initialization time; a table that is fixed at compile time can be a
+* constexpr StaticOrderedMap (StaticOrderedMap.h) instead, which needs no initialization at all.
+*
 * OrderedQMap provides a Fluent Interface API.
 *
 * \file OrderedQMap.h
@@ -52,383 +86,3627 @@
 namespace ActionNet
 {
 
-    //ordered QMap that must have UNIQUE keys to get correct results of indexed (...at) methods
-    template <class Key, class T> class OrderedQMap : public QMap<Key,T>, private QList<Key>
+    //QDataStream format of the ordered containers:
+    //  quint32 Magic, quint8 Version, qint32 count, then count x (key, value) in insertion order.
+    //Streams written before the format was versioned start with the quint32 size of the key list
+    //followed by a QMap of the values; the readers tell both apart by the first quint32.
+    struct OrderedQMapStream
     {
-        //ToDo
-        // Do not use specified functions of QMap until they are not implemented here:
-        //    erase(), insertMulti(), swap(), take(), unite()
-        // Do not use write functions of QList until they are not implemented here.
-    public:
-        using typename QMap<Key,T>::iterator;
-        using typename QMap<Key,T>::const_iterator;
-
-        typename QMap<Key,T>::iterator begin() { return QMap<Key,T>::begin(); }
-
-        typename QMap<Key,T>::const_iterator begin() const { return QMap<Key,T>::begin(); }
-
-        typename QMap<Key,T>::iterator end() { return QMap<Key,T>::end(); }
+        enum : quint32 { Magic = 0xFFFFFFFFu };
+        enum : quint8 { Version = 1 };
 
-        typename QMap<Key,T>::const_iterator end() const { return QMap<Key,T>::end(); }
+        enum { MaxReservation = 1024 };
 
-        //overrides QList::contains method
-        bool contains(const Key & key) const { return QList<Key>::contains(key); }
+        //what a reader presizes for count entries; count comes from the stream and may be corrupt,
+        //so the containers only grow beyond this as the entries actually arrive
+        static int reservation(qint32 count) { return qMin(count, qint32(MaxReservation)); }
 
-        bool contains(const QString & key, Qt::CaseSensitivity cs) const
+        static void writeHeader(QDataStream &out, int count)
         {
-          //QList<QString> keys = this->keys();
-          QStringList keys = this->keys();
-          return keys.contains(key, cs);
+          out << quint32(Magic) << quint8(Version) << qint32(count);
         }
 
-        //overrides QList::operator method
-        const T operator[](Key & key) const { return QMap<Key,T>::value(key); }
-
-        T & operator[](Key & key)
+        //reads the header and stores the number of entries in count; legacy is set
+        //when count is the size of the key list of a legacy stream instead.
+        //Returns false and sets the stream status if the data is corrupt or of a newer version.
+        static bool readHeader(QDataStream &in, qint32 &count, bool &legacy)
         {
-          if (!QList<Key>::contains(key))
-             QList<Key>::append(key);
-          return QMap<Key,T>::operator [](key);
+          quint32 head = 0;
+          in >> head;
+          legacy = head != quint32(Magic);
+          if (legacy)
+          {
+            count = qint32(head);
+            if (count < 0)
+              in.setStatus(QDataStream::ReadCorruptData);
+            return in.status() == QDataStream::Ok;
+          }
+          quint8 version = 0;
+          count = 0;
+          in >> version >> count;
+          if (in.status() == QDataStream::Ok && (version > Version || count < 0))
+            in.setStatus(QDataStream::ReadCorruptData);
+          return in.status() == QDataStream::Ok;
         }
 
-        //overrides QMap::operator method
-        const T operator[](const Key & key) const { return QMap<Key,T>::value(key); }
-
-        T & operator[](const Key & key)
+        //reads the key list of a legacy stream, whose size has already been read by readHeader()
+        template <class Key>
+        static bool readLegacyKeys(QDataStream &in, qint32 count, QList<Key> &keys)
         {
-          if (!QList<Key>::contains(key))
-            QList<Key>::append(key);
-          return QMap<Key,T>::operator [](key);
+          keys.reserve(reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Key k;
+            in >> k;
+            if (in.status() != QDataStream::Ok)
+              return false;
+            keys.append(k);
+          }
+          return true;
         }
 
-        typename QMap<Key, T>::iterator insert(const Key & key, const T & value)
+        //reads the rest of a legacy stream whose key list holds count keys and inserts it into obj
+        template <class Key, class T, class Container>
+        static void readLegacy(QDataStream &in, qint32 count, Container &obj)
         {
-          typename QMap<Key, T>::iterator iter = QMap<Key,T>::insert(key, value);
-          if (!QList<Key>::contains(key))
-             QList<Key>::append(key);
-          return iter;
+          QList<Key> keys;
+          if (!readLegacyKeys(in, count, keys))
+            return;
+          QMap<Key, T> tmpMap;
+          in >> tmpMap;
+          for (const Key & k : keys)
+            obj.insert(k, tmpMap.value(k));
         }
+    };
 
-        typename QMap<Key, T>::iterator append(const Key & key, const T & value) { return insert(key, value); }
+    //key policies of the ordered containers.
+    //CaseInsensitiveKeys (QString keys only) keeps a second index of the case-folded keys, which makes
+    //contains(key, Qt::CaseInsensitive) and value(key, Qt::CaseInsensitive) O(1) without allocating;
+    //with the default CaseSensitiveKeys these fall back to comparing every key.
+    //The same index answers lookups by QStringView, QLatin1String or const char* without building a
+    //QString key, StringViewKeys names the policy for that use.
+    struct CaseSensitiveKeys { enum { CaseFoldedIndex = false }; };
+    struct CaseInsensitiveKeys { enum { CaseFoldedIndex = true }; };
+    typedef CaseInsensitiveKeys StringViewKeys;
 
-        typename QMap<Key, T>::iterator prepend(const Key & key, const T & value)
-        {
-          typename QMap<Key, T>::iterator iter = QMap<Key,T>::insert(key, value);
-          if (!QList<Key>::contains(key))
-             QList<Key>::prepend(key);
-          return iter;
-        }
+    //string types accepted by the lookup overloads of QString keyed containers.
+    //toString() builds the QString key when the policy keeps no folded index; const char* is UTF-8.
+    template <class View> struct OrderedQMapStringView { enum { Enabled = false }; };
 
-        Key replaceAt(int index, const T & value)
-        {
-          Key key = QList<Key>::at(index);
-          QMap<Key,T>::insert(key, value);
-          return key;
-        }
+    template <> struct OrderedQMapStringView<QStringView>
+    {
+        enum { Enabled = true };
+        static QString toString(QStringView key) { return key.toString(); }
+    };
 
-        T at(int index) const
-        {
-           Key key = QList<Key>::at(index);
-           return  QMap<Key,T>::value(key);
-        }
+    template <> struct OrderedQMapStringView<QLatin1String>
+    {
+        enum { Enabled = true };
+        static QString toString(QLatin1String key) { return QString(key); }
+    };
 
-        T value(int index) const
-        {
-           Key key = QList<Key>::value(index);
-           return  QMap<Key,T>::value(key);
-        }
+    template <> struct OrderedQMapStringView<const char *>
+    {
+        enum { Enabled = true };
+        static QString toString(const char * key) { return QString::fromUtf8(key); }
+    };
 
-        int remove(const Key &key)
+    //case-folded key index used by the CaseInsensitiveKeys policy; empty and unused otherwise
+    template <class Key, bool Enabled> class OrderedQMapFoldedIndex
+    {
+    public:
+        void insert(const Key &) {}
+        void remove(const Key &) {}
+        void clear() {}
+        const Key *find(const QString &) const { return nullptr; }
+        template <class View> const Key *find(View, Qt::CaseSensitivity) const { return nullptr; }
+    };
+
+    template <class Key> class OrderedQMapFoldedIndex<Key, true>
+    {
+    public:
+        void insert(const Key & key) { m_keys.insert(hash(QStringView(key)), key); }
+
+        void remove(const Key & key) { m_keys.remove(hash(QStringView(key)), key); }
+
+        void clear() { m_keys.clear(); }
+
+        //the stored key equal to key ignoring case, or nullptr
+        const Key *find(const QString & key) const { return find(QStringView(key), Qt::CaseInsensitive); }
+
+        //the stored key equal to key, compared with cs; an exact match is among the case variants of key
+        const Key *find(QStringView key, Qt::CaseSensitivity cs) const { return lookup(key, cs); }
+
+        const Key *find(QLatin1String key, Qt::CaseSensitivity cs) const { return lookup(key, cs); }
+
+        //plain ASCII is looked up as Latin-1, anything else has to be decoded first
+        const Key *find(const char * key, Qt::CaseSensitivity cs) const
         {
-           int i = QList<Key>::indexOf(key);
-           QList<Key>::removeAt(i);
-           QMap<Key,T>::remove(key);
-           return i;
+          const char * end = key;
+          while (*end && uchar(*end) < 0x80)
+            ++end;
+          if (!*end)
+            return lookup(QLatin1String(key, int(end - key)), cs);
+          const QString decoded = QString::fromUtf8(key);
+          return lookup(QStringView(decoded), cs);
         }
 
-        Key removeAt(int i)
+        //hash of the case-folded key, folded char by char instead of building a folded copy
+        static uint hash(QStringView key)
         {
-            Key key = this->key(i);
-            QList<Key>::removeAt(i);
-            QMap<Key,T>::remove(key);
-            return key;
+          uint h = 0;
+          const QChar * c = key.data();
+          const QChar * end = c + key.size();
+          for (; c != end; ++c)
+          {
+            uint u = c->unicode();
+            if (QChar::isHighSurrogate(u) && c + 1 != end && c[1].isLowSurrogate())
+            {
+              u = QChar::surrogateToUcs4(c[0], c[1]);
+              ++c;
+            }
+            h = 31 * h + QChar::toCaseFolded(u);
+          }
+          return h;
         }
 
-        Key removeLast()
+        //equal to the hash of the same text as QStringView
+        static uint hash(QLatin1String key)
         {
-            Key key = QList<Key>::last();
-            this->remove(key);
-            return key;
+          uint h = 0;
+          const char * c = key.data();
+          const char * end = c + key.size();
+          for (; c != end; ++c)
+            h = 31 * h + QChar::toCaseFolded(uint(uchar(*c)));
+          return h;
         }
 
-        QPair<Key, T> last() const
+    private:
+        QMultiHash<uint, Key> m_keys;
+
+        static int compare(const Key & stored, QStringView key, Qt::CaseSensitivity cs) { return QStringView(stored).compare(key, cs); }
+
+        static int compare(const Key & stored, QLatin1String key, Qt::CaseSensitivity cs) { return stored.compare(key, cs); }
+
+        template <class View> const Key *lookup(View key, Qt::CaseSensitivity cs) const
         {
-           if(QList<Key>::isEmpty())
-             return QPair<Key, T>();
-           Key key = QList<Key>::last();
-           T val = this->value(key);
-           return QPair<Key, T>(key, val);
+          const uint h = hash(key);
+          for (typename QMultiHash<uint, Key>::const_iterator it = m_keys.constFind(h); it != m_keys.constEnd() && it.key() == h; ++it)
+            if (compare(it.value(), key, cs) == 0)
+              return &it.value();
+          return nullptr;
         }
+    };
 
-        bool isEmpty() const
-        { return QMap<Key,T>::isEmpty(); }
+    //pair of iterators usable in range-for, e.g. for (const T & v : map.ordered())
+    template <class Iterator> class OrderedQMapRange
+    {
+    public:
+        OrderedQMapRange(Iterator first, Iterator last) : m_begin(first), m_end(last) {}
 
-        //overrides QList value methods
-        const T value(Key & key) const
-        { return QMap<Key,T>::value(key, T()); }
+        Iterator begin() const { return m_begin; }
 
-        const T value(Key & key, const T & defaultValue) const
-        { return QMap<Key,T>::value(key, defaultValue); }
+        Iterator end() const { return m_end; }
 
-        //overrides QMap value methods
-        const T value(const Key & key) const
-        { return QMap<Key,T>::value(key, T()); }
+    private:
+        Iterator m_begin;
+        Iterator m_end;
+    };
 
-        const T value(const Key & key, const T & defaultValue) const
-        { return QMap<Key,T>::value(key, defaultValue); }
+    //adapts an ordered iterator so that operator* gives the key (see keysView())
+    template <class Key, class Iterator> class OrderedQMapKeyIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef qptrdiff difference_type;
+        typedef Key value_type;
+        typedef const Key *pointer;
+        typedef const Key &reference;
 
-        QMap<Key, T> toQMap() { return *this; }
+        OrderedQMapKeyIterator() {}
+        explicit OrderedQMapKeyIterator(Iterator o) : i(o) {}
 
-        QList<T> values() const
+        const Key &operator*() const { return i.key(); }
+        const Key *operator->() const { return &i.key(); }
+
+        bool operator==(const OrderedQMapKeyIterator &o) const { return i == o.i; }
+        bool operator!=(const OrderedQMapKeyIterator &o) const { return i != o.i; }
+        OrderedQMapKeyIterator &operator++() { ++i; return *this; }
+        OrderedQMapKeyIterator operator++(int) { OrderedQMapKeyIterator r = *this; ++i; return r; }
+        OrderedQMapKeyIterator &operator--() { --i; return *this; }
+        OrderedQMapKeyIterator operator--(int) { OrderedQMapKeyIterator r = *this; --i; return r; }
+
+        Iterator base() const { return i; }
+
+    private:
+        Iterator i;
+    };
+
+    //adapts an ordered iterator so that operator* gives std::pair<const Key &, T &>, like QKeyValueIterator
+    //(see pairsView()); T is const qualified for the const views
+    template <class Key, class T, class Iterator> class OrderedQMapKeyValueIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef qptrdiff difference_type;
+        typedef std::pair<const Key &, T &> value_type;
+        typedef void pointer;
+        typedef value_type reference;
+
+        OrderedQMapKeyValueIterator() {}
+        explicit OrderedQMapKeyValueIterator(Iterator o) : i(o) {}
+
+        std::pair<const Key &, T &> operator*() const { return std::pair<const Key &, T &>(i.key(), i.value()); }
+
+        bool operator==(const OrderedQMapKeyValueIterator &o) const { return i == o.i; }
+        bool operator!=(const OrderedQMapKeyValueIterator &o) const { return i != o.i; }
+        OrderedQMapKeyValueIterator &operator++() { ++i; return *this; }
+        OrderedQMapKeyValueIterator operator++(int) { OrderedQMapKeyValueIterator r = *this; ++i; return r; }
+        OrderedQMapKeyValueIterator &operator--() { --i; return *this; }
+        OrderedQMapKeyValueIterator operator--(int) { OrderedQMapKeyValueIterator r = *this; --i; return r; }
+
+        Iterator base() const { return i; }
+
+    private:
+        Iterator i;
+    };
+
+    //conversion of a stored value by valueAs() and atAs(). A QVariant holding V is read in place; any
+    //other is converted on a shallow copy and gives defaultValue when the conversion fails, e.g. for
+    //"abc" to int, which canConvert() would allow
+    template <class T> struct OrderedQMapValueCast
+    {
+        template <class V> static V convert(const T & value, const V &) { return V(value); }
+    };
+
+    template <> struct OrderedQMapValueCast<QVariant>
+    {
+        template <class V> static V convert(const QVariant & value, const V & defaultValue)
         {
-          QList<T> res;
-          QList<Key> keys = this->keys();
-          for (Key key : keys)
-            res.append(this->value(key));
-          return res;
+          if (value.userType() == qMetaTypeId<V>())
+            return *static_cast<const V *>(value.constData());
+          QVariant copy = value;
+          if (!copy.convert(qMetaTypeId<V>()))
+            return defaultValue;
+          return copy.value<V>();
         }
 
-        QList<QPair<T, Key> > valueKeyList(bool addEmptyPair = false, bool putEmptyPairAsFirst = true) const
+        static QVariant convert(const QVariant & value, const QVariant &) { return value; }
+    };
+
+    //what one OrderedQMap did since it was created or resetStats() was called.
+    //Only counted when ORDEREDQMAP_STATISTICS is defined (for the whole program) before OrderedQMap.h
+    //is included; otherwise stats() returns zeros and the counting compiles to nothing.
+    //The counters are atomic and counted with relaxed ordering, so const methods may count from several
+    //threads at once; stats() reads each counter on its own, not all of them at one instant.
+    struct OrderedQMapStats
+    {
+        qint64 inserts;         //keys added
+        qint64 lookups;         //lookups by key or position
+        qint64 linearScans;     //case insensitive lookups without a folded index, which compare key by key
+        qint64 probes;          //keys compared by those scans
+        qint64 reallocations;   //growths of the key index
+        qint64 detaches;        //writes that detached the QMap or the order list from a copy
+        qint64 serializedBytes; //bytes written by operator<< to a random access device
+    };
+
+#ifdef ORDEREDQMAP_STATISTICS
+    class OrderedQMapCounters
+    {
+    public:
+        OrderedQMapCounters() {}
+
+        //a copy starts with the counts of the original
+        OrderedQMapCounters(const OrderedQMapCounters & o) { copyFrom(o); }
+
+        OrderedQMapCounters &operator=(const OrderedQMapCounters & o)
         {
-          QList<QPair<T, Key> > res;
-          QList<Key> keys = this->keys();
-          for (Key key : keys)
-            res.append(qMakePair(this->value(key), key));
-          if (addEmptyPair)
-          {
-              if (putEmptyPairAsFirst)
-                res.prepend(qMakePair(T(), Key()));
-              else
-                res.append(qMakePair(T(), Key()));
-          }
-          return res;
+          copyFrom(o);
+          return *this;
         }
 
-        Key key(int index) const { return QList<Key>::value(index);}
-
-        int size() const { return QMap<Key,T>::size(); }
+        OrderedQMapStats stats() const
+        {
+          OrderedQMapStats s;
+          s.inserts = m_inserts.loadAcquire();
+          s.lookups = m_lookups.loadAcquire();
+          s.linearScans = m_linearScans.loadAcquire();
+          s.probes = m_probes.loadAcquire();
+          s.reallocations = m_reallocations.loadAcquire();
+          s.detaches = m_detaches.loadAcquire();
+          s.serializedBytes = m_serializedBytes.loadAcquire();
+          return s;
+        }
 
-        int count(const Key &key) const { return QMap<Key,T>::count(key); }
+        void resetStats() { copyFrom(OrderedQMapCounters()); }
 
-        int length() const { return QMap<Key, T>::size(); }
+    protected:
+        void countInsert() const { m_inserts.fetchAndAddRelaxed(1); }
 
-        QList<Key> keys() const { return *this; }
+        void countLookup() const { m_lookups.fetchAndAddRelaxed(1); }
 
-        int keyOrder(const Key &key) const
+        void countScan(int probes) const
         {
-            auto keysTmp = keys();
-            return keysTmp.indexOf(key);
+          m_linearScans.fetchAndAddRelaxed(1);
+          m_probes.fetchAndAddRelaxed(probes);
         }
 
-        void clear()
+        template <class Container> int capacityOf(const Container & c) const { return c.capacity(); }
+
+        template <class Container> void countReallocation(const Container & c, int capacity) const
         {
-           QMap<Key,T>::clear();
-           QList<Key>::clear();
+          if (c.capacity() != capacity)
+            m_reallocations.fetchAndAddRelaxed(1);
         }
 
-        OrderedQMap<Key, T>& operator()(const Key & key, const T & value)
+        //bit 0 for a shared a, bit 1 for a shared b; taken before a write and passed to countDetach()
+        //after it, so writes that turn out to change nothing, like removing a missing key, are not counted
+        template <class A, class B> int sharedParts(const A & a, const B & b) const
         {
-            QMap<Key,T>::insert(key, value);
-            if (!QList<Key>::contains(key))
-              QList<Key>::append(key);
-            return *this;
+          return (a.isDetached() ? 0 : 1) | (b.isDetached() ? 0 : 2);
         }
 
-        OrderedQMap<Key,T> &operator<< (const QPair<Key,T> &t)
+        template <class A, class B> void countDetach(int shared, const A & a, const B & b) const
         {
-          this->insert(t.first, t.second);
-          return *this;
+          if (((shared & 1) && a.isDetached()) || ((shared & 2) && b.isDetached()))
+            m_detaches.fetchAndAddRelaxed(1);
         }
 
-        OrderedQMap<Key,T> &operator>> (const QPair<Key,T> &t)
+        qint64 streamPos(const QDataStream & out) const
         {
-          this->prepend(t.first, t.second);
-          return *this;
+          QIODevice * device = out.device();
+          return device && !device->isSequential() ? device->pos() : -1;
         }
 
-        friend QDataStream &operator <<(QDataStream &out, const OrderedQMap<Key,T> &obj)
+        void countSerialized(const QDataStream & out, qint64 start) const
         {
-          QList<Key> keys = obj.keys();
-          QMap<Key, T> tmpMap;
-          for(Key k : keys)
-              tmpMap.insert(k, obj.value(k));
-          out << obj.keys() << tmpMap;
-          return out;
+          if (start >= 0)
+            m_serializedBytes.fetchAndAddRelaxed(streamPos(out) - start);
         }
 
-        friend QDataStream &operator >>(QDataStream &in, OrderedQMap<Key,T> &obj)
+    private:
+        mutable QAtomicInteger<qint64> m_inserts;
+        mutable QAtomicInteger<qint64> m_lookups;
+        mutable QAtomicInteger<qint64> m_linearScans;
+        mutable QAtomicInteger<qint64> m_probes;
+        mutable QAtomicInteger<qint64> m_reallocations;
+        mutable QAtomicInteger<qint64> m_detaches;
+        mutable QAtomicInteger<qint64> m_serializedBytes;
+
+        void copyFrom(const OrderedQMapCounters & o)
         {
-          QList<Key> keys;
-          QMap<Key, T> tmpMap;
-          in >> keys >> tmpMap;
-          for(Key k : keys)
-             obj.insert(k, tmpMap.value(k));
-          return in;
+          m_inserts.storeRelease(o.m_inserts.loadAcquire());
+          m_lookups.storeRelease(o.m_lookups.loadAcquire());
+          m_linearScans.storeRelease(o.m_linearScans.loadAcquire());
+          m_probes.storeRelease(o.m_probes.loadAcquire());
+          m_reallocations.storeRelease(o.m_reallocations.loadAcquire());
+          m_detaches.storeRelease(o.m_detaches.loadAcquire());
+          m_serializedBytes.storeRelease(o.m_serializedBytes.loadAcquire());
         }
+    };
+#else
+    //empty, so it takes no space as a base class
+    class OrderedQMapCounters
+    {
+    public:
+        OrderedQMapStats stats() const { return OrderedQMapStats(); }
+
+        void resetStats() {}
+
+    protected:
+        void countInsert() const {}
+
+        void countLookup() const {}
 
+        void countScan(int) const {}
+
+        template <class Container> int capacityOf(const Container &) const { return 0; }
+
+        template <class Container> void countReallocation(const Container &, int) const {}
+
+        template <class A, class B> int sharedParts(const A &, const B &) const { return 0; }
+
+        template <class A, class B> void countDetach(int, const A &, const B &) const {}
+
+        qint64 streamPos(const QDataStream &) const { return -1; }
+
+        void countSerialized(const QDataStream &, qint64) const {}
     };
+#endif
 
-    template <class Key, class T> class OrderedQMultiMap : public QMultiMap<Key,T>, private QList<Key>
+    //parallel bulk operations, see OrderedQMapParallel.h
+    struct OrderedQMapParallel;
+
+    //ordered QMap that must have UNIQUE keys to get correct results of indexed (...at) methods
+    template <class Key, class T, class KeyPolicy = CaseSensitiveKeys> class OrderedQMap : public QMap<Key,T>, private QList<Key>, private OrderedQMapCounters
     {
         //ToDo
-        // Do not use specified functions of QMultiMap until they are not implemented here:
-        //    erase(), swap(), take(), unite()
+        // Do not use specified functions of QMap until they are not implemented here:
+        //    insertMulti()
         // Do not use write functions of QList until they are not implemented here.
-
     public:
-        //overrides QList::contains method
-        bool contains(const Key & key) const { return QList<Key>::contains(key); }
+        using typename QMap<Key,T>::iterator;
+        using typename QMap<Key,T>::const_iterator;
+        using OrderedQMapCounters::stats;
+        using OrderedQMapCounters::resetStats;
 
-        //introduces case (in)sensitive contains lije QStringList has.
-        bool contains(const Key & key, Qt::CaseSensitivity cs) const
-        {
-          QString strKey = QVariant(key).toString();
-          QList<Key> keys = this->keys();
-          for (Key k : keys)
-          {
-            QString str = QVariant(k).toString();
-            if (strKey.compare(str, cs) == 0)
-              return true;
-          }
-          return false;
-        }
+        OrderedQMap() {}
 
-        //overrides QList::operator method
-        const T operator[](Key & key) const { return QMultiMap<Key,T>::value(key); }
+        //inserts the pairs in list order, like chained operator<< calls
+        OrderedQMap(std::initializer_list<QPair<Key,T> > list) { insertRange(list.begin(), list.end()); }
 
-        T & operator[](Key & key)
-        {
-          if (!QList<Key>::contains(key))
-            QList<Key>::append(key);
-          return QMap<Key,T>::operator [](key);
-        }
+        typename QMap<Key,T>::iterator begin() { return QMap<Key,T>::begin(); }
 
-        //overrides QMultiMap::operator method
-        const T operator[](const Key & key) const { return QMultiMap<Key,T>::value(key); }
+        typename QMap<Key,T>::const_iterator begin() const { return QMap<Key,T>::begin(); }
 
-        T & operator[](const Key & key)
-        {
-          if (!QList<Key>::contains(key))
-            QList<Key>::append(key);
+        typename QMap<Key,T>::iterator end() { return QMap<Key,T>::end(); }
 
-          return QMultiMap<Key,T>::operator [](key);
-        }
+        typename QMap<Key,T>::const_iterator end() const { return QMap<Key,T>::end(); }
 
-        typename QMap<Key, T>::iterator insert(const Key & key, const T & value)
+        //iterates in insertion order; like QMap::iterator, operator* gives the value and key() the key.
+        //Each step reads the key from the order list and looks its value up in the QMap, no copies are made.
+        class ordered_iterator
         {
-          typename QMap<Key, T>::iterator iter = QMultiMap<Key,T>::insert(key, value);
-          QList<Key>::append(key);
-          return iter;
-        }
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef qptrdiff difference_type;
+            typedef T value_type;
+            typedef T *pointer;
+            typedef T &reference;
 
-        typename QMap<Key, T>::iterator append(const Key & key, const T & value) { return insert(key, value); }
+            ordered_iterator() : c(nullptr), i(0) {}
 
-        typename QMap<Key, T>::iterator prepend(const Key & key, const T & value)
-        {
-          typename QMap<Key, T>::iterator iter = QMultiMap<Key,T>::insert(key, value);
-          if (!QList<Key>::contains(key))
-             QList<Key>::prepend(key);
-          return iter;
-        }
+            const Key &key() const { return c->QList<Key>::at(i); }
+            T &value() const { return c->QMap<Key,T>::find(key()).value(); }
+            T &operator*() const { return value(); }
+            T *operator->() const { return &value(); }
 
-        typename QMap<Key, T>::iterator replace(const Key & key, const T & value)
-        {
-          if (!QList<Key>::contains(key))
-            QList<Key>::append(key);
-          typename QMap<Key, T>::iterator iter = QMultiMap<Key,T>::replace(key, value);
-          return iter;
-        }
+            //position of the current entry in the insertion order
+            int index() const { return i; }
 
-        typename QMap<Key, T>::iterator find(const Key & key) const { return QMultiMap<Key,T>::find(key); }
+            bool operator==(const ordered_iterator &o) const { return i == o.i; }
+            bool operator!=(const ordered_iterator &o) const { return i != o.i; }
+            ordered_iterator &operator++() { ++i; return *this; }
+            ordered_iterator operator++(int) { ordered_iterator r = *this; ++i; return r; }
+            ordered_iterator &operator--() { --i; return *this; }
+            ordered_iterator operator--(int) { ordered_iterator r = *this; --i; return r; }
 
-        int remove(const Key &key)
-        {
-           QList<Key>::removeAll(key); //QList<Key>::removeAt(i);
-           int i = QMultiMap<Key,T>::remove(key);
-           return i;
-        }
+        private:
+            friend class OrderedQMap;
+            ordered_iterator(OrderedQMap *container, int index) : c(container), i(index) {}
 
-        T last() const
+            OrderedQMap *c;
+            int i;
+        };
+
+        class const_ordered_iterator
         {
-           if(QList<Key>::isEmpty())
-              return T();
-           Key key = QList<Key>::last();
-           return this->value(key);
-        }
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef qptrdiff difference_type;
+            typedef T value_type;
+            typedef const T *pointer;
+            typedef const T &reference;
 
-        bool isEmpty() const { return QMultiMap<Key,T>::isEmpty(); }
+            const_ordered_iterator() : c(nullptr), i(0) {}
+            const_ordered_iterator(const ordered_iterator &o) : c(o.c), i(o.i) {}
 
-        //overrides QList value methods
-        const T value(Key & key) const { return QMultiMap<Key,T>::value(key, T()); }
+            const Key &key() const { return c->QList<Key>::at(i); }
+            const T &value() const { return c->QMap<Key,T>::constFind(key()).value(); }
+            const T &operator*() const { return value(); }
+            const T *operator->() const { return &value(); }
 
-        const T value(Key & key, const T & defaultValue) const { return QMultiMap<Key,T>::value(key, defaultValue); }
+            int index() const { return i; }
 
-        //overrides QMultiMap value methods
-        const T value(const Key & key) const { return QMultiMap<Key,T>::value(key, T()); }
+            bool operator==(const const_ordered_iterator &o) const { return i == o.i; }
+            bool operator!=(const const_ordered_iterator &o) const { return i != o.i; }
+            const_ordered_iterator &operator++() { ++i; return *this; }
+            const_ordered_iterator operator++(int) { const_ordered_iterator r = *this; ++i; return r; }
+            const_ordered_iterator &operator--() { --i; return *this; }
+            const_ordered_iterator operator--(int) { const_ordered_iterator r = *this; --i; return r; }
 
-        const T value(const Key & key, const T & defaultValue) const { return QMultiMap<Key,T>::value(key, defaultValue); }
+        private:
+            friend class OrderedQMap;
+            const_ordered_iterator(const OrderedQMap *container, int index) : c(container), i(index) {}
 
-        Key key(int index) const { return QList<Key>::value(index); }
+            const OrderedQMap *c;
+            int i;
+        };
 
-        int size() const { return QMultiMap<Key,T>::size(); }
+        ordered_iterator orderedBegin() { return ordered_iterator(this, 0); }
 
-        int count(const Key &key) const { return QMap<Key,T>::count(key); }
+        const_ordered_iterator orderedBegin() const { return const_ordered_iterator(this, 0); }
 
-        int length() const { return QMap<Key, T>::size(); }
+        ordered_iterator orderedEnd() { return ordered_iterator(this, QList<Key>::size()); }
 
-        QList<Key> keys() const {return *this;}
+        const_ordered_iterator orderedEnd() const { return const_ordered_iterator(this, QList<Key>::size()); }
 
-        void clear()
+        const_ordered_iterator constOrderedBegin() const { return orderedBegin(); }
+
+        const_ordered_iterator constOrderedEnd() const { return orderedEnd(); }
+
+        OrderedQMapRange<ordered_iterator> ordered() { return OrderedQMapRange<ordered_iterator>(orderedBegin(), orderedEnd()); }
+
+        OrderedQMapRange<const_ordered_iterator> ordered() const { return OrderedQMapRange<const_ordered_iterator>(orderedBegin(), orderedEnd()); }
+
+        //allocation free views of the ordered data, e.g. for (const Key & k : map.keysView())
+        typedef OrderedQMapRange<OrderedQMapKeyIterator<Key, const_ordered_iterator> > KeysView;
+        typedef OrderedQMapRange<const_ordered_iterator> ValuesView;
+        typedef OrderedQMapRange<OrderedQMapKeyValueIterator<Key, const T, const_ordered_iterator> > PairsView;
+        typedef OrderedQMapRange<OrderedQMapKeyValueIterator<Key, T, ordered_iterator> > MutablePairsView;
+
+        KeysView keysView() const
         {
-           QMultiMap<Key,T>::clear();
-           QList<Key>::clear();
+          typedef OrderedQMapKeyIterator<Key, const_ordered_iterator> It;
+          return KeysView(It(orderedBegin()), It(orderedEnd()));
         }
 
-        OrderedQMultiMap<Key, T>& operator()(const Key & key, const T & value)
+        ValuesView valuesView() const { return ordered(); }
+
+        PairsView pairsView() const
         {
-            QMultiMap<Key,T>::insert(key, value);
-            QList<Key>::append(key);
-            return *this;
+          typedef OrderedQMapKeyValueIterator<Key, const T, const_ordered_iterator> It;
+          return PairsView(It(orderedBegin()), It(orderedEnd()));
         }
 
-
-        OrderedQMultiMap<Key,T> &operator<< (const QPair<Key,T> &t)
+        MutablePairsView pairsView()
         {
-          this->insert(t.first, t.second);
-          return *this;
+          typedef OrderedQMapKeyValueIterator<Key, T, ordered_iterator> It;
+          return MutablePairsView(It(orderedBegin()), It(orderedEnd()));
         }
 
-        friend QDataStream &operator <<(QDataStream &out, const OrderedQMultiMap<Key,T> &obj)
+        //builds a map ordered like pairs; a repeated key keeps its first position and its last value.
+        //The key index is built in one pass and, as long as the keys come in ascending order, the QMap
+        //is filled by appending at its end instead of searching the tree for every key.
+        static OrderedQMap fromOrderedPairs(const QList<QPair<Key,T> > & pairs)
         {
-          QList<Key> keys = obj.keys();
-          QMultiMap<Key, T> tmpMap;
-          for(Key k : keys)
-              tmpMap.insert(k, obj.value(k));
-          out << obj.keys() << tmpMap;
-          return out;
+          OrderedQMap map;
+          map.reserve(pairs.size());
+          bool ascending = true;
+          for (int i = 0; i < pairs.size(); ++i)
+          {
+            const QPair<Key,T> & pair = pairs.at(i);
+            if (ascending && i > 0 && !(pairs.at(i - 1).first < pair.first))
+              ascending = false;
+            if (ascending)
+              map.QMap<Key,T>::insert(map.QMap<Key,T>::constEnd(), pair.first, pair.second);
+            else
+              map.QMap<Key,T>::insert(pair.first, pair.second);
+            map.appendKey(pair.first);
+          }
+          return map;
         }
 
-        friend QDataStream &operator >>(QDataStream &in, OrderedQMultiMap<Key,T> &obj)
+        //like fromOrderedPairs for pairs whose keys are strictly ascending, which is checked up front
+        //in one sweep; the index is then filled without duplicate lookups.
+        //Falls back to fromOrderedPairs when the keys are not ascending or not unique.
+        static OrderedQMap fromSortedUnique(const QList<QPair<Key,T> > & pairs)
         {
-          QList<Key> keys;
-          QMultiMap<Key, T> tmpMap;
-          in >> keys >> tmpMap;
-          for(Key k : keys)
-                obj.insert(k, tmpMap.value(k));
-          return in;
+          for (int i = 1; i < pairs.size(); ++i)
+            if (!(pairs.at(i - 1).first < pairs.at(i).first))
+              return fromOrderedPairs(pairs);
+          OrderedQMap map;
+          map.reserve(pairs.size());
+          for (int i = 0; i < pairs.size(); ++i)
+          {
+            const Key & key = pairs.at(i).first;
+            map.QMap<Key,T>::insert(map.QMap<Key,T>::constEnd(), key, pairs.at(i).second);
+            map.m_keyIndex.insert(key, i);
+            map.m_foldedKeys.insert(key);
+            map.QList<Key>::append(key);
+          }
+          return map;
         }
 
-        QMultiMap<Key,T> toQMap() { return *this; }
+        //preallocates the order list and key index for n keys in total; QMap itself has no reserve
+        void reserve(int n)
+        {
+          QList<Key>::reserve(n);
+          m_keyIndex.reserve(n);
+        }
+
+        //inserts every pair of [first, last) in order, like chained insert() calls
+        template <class InputIterator> void insertRange(InputIterator first, InputIterator last)
+        {
+          reserveRange(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
+          for (; first != last; ++first)
+            insert((*first).first, (*first).second);
+        }
+
+        //overrides QList::contains method, O(1) lookup in the key index
+        bool contains(const Key & key) const
+        {
+          countLookup();
+          return m_keyIndex.contains(key);
+        }
+
+        bool contains(const QString & key, Qt::CaseSensitivity cs) const
+        {
+          if (cs == Qt::CaseSensitive)
+            return contains(key);
+          countLookup();
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key) != nullptr;
+          return findKey(key) != nullptr;
+        }
+
+        //overrides QList::operator method
+        const T operator[](Key & key) const { return value(key); }
+
+        T & operator[](Key & key)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          appendKey(key);
+          T & res = QMap<Key,T>::operator [](key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return res;
+        }
+
+        //overrides QMap::operator method
+        const T operator[](const Key & key) const { return value(key); }
+
+        T & operator[](const Key & key)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          appendKey(key);
+          T & res = QMap<Key,T>::operator [](key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return res;
+        }
+
+        typename QMap<Key, T>::iterator insert(const Key & key, const T & value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          typename QMap<Key, T>::iterator iter = QMap<Key,T>::insert(key, value);
+          appendKey(key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return iter;
+        }
+
+        typename QMap<Key, T>::iterator insert(const Key & key, T && value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          typename QMap<Key, T>::iterator iter = assign(key, std::move(value));
+          appendKey(key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return iter;
+        }
+
+        typename QMap<Key, T>::iterator append(const Key & key, const T & value) { return insert(key, value); }
+
+        typename QMap<Key, T>::iterator append(const Key & key, T && value) { return insert(key, std::move(value)); }
+
+        typename QMap<Key, T>::iterator prepend(const Key & key, const T & value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          typename QMap<Key, T>::iterator iter = QMap<Key,T>::insert(key, value);
+          prependKey(key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return iter;
+        }
+
+        typename QMap<Key, T>::iterator prepend(const Key & key, T && value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          typename QMap<Key, T>::iterator iter = assign(key, std::move(value));
+          prependKey(key);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return iter;
+        }
+
+        //builds a temporary T from args and moves it into the map like insert(key, T &&), replacing an existing value
+        template <class... Args> typename QMap<Key, T>::iterator emplace(const Key & key, Args &&... args)
+        { return insert(key, T(std::forward<Args>(args)...)); }
+
+        template <class... Args> typename QMap<Key, T>::iterator emplaceBack(const Key & key, Args &&... args)
+        { return insert(key, T(std::forward<Args>(args)...)); }
+
+        template <class... Args> typename QMap<Key, T>::iterator emplaceFront(const Key & key, Args &&... args)
+        { return prepend(key, T(std::forward<Args>(args)...)); }
+
+        //like emplace, but leaves an existing value of key untouched and does not build a T for it;
+        //the bool is true when key was inserted
+        template <class... Args> QPair<typename QMap<Key, T>::iterator, bool> tryEmplace(const Key & key, Args &&... args)
+        {
+          typename QMap<Key, T>::iterator iter = QMap<Key,T>::find(key);
+          if (iter != QMap<Key,T>::end())
+            return qMakePair(iter, false);
+          return qMakePair(insert(key, T(std::forward<Args>(args)...)), true);
+        }
+
+        Key replaceAt(int index, const T & value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          const Key & key = QList<Key>::at(index);
+          QMap<Key,T>::insert(key, value);
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return key;
+        }
+
+        Key replaceAt(int index, T && value)
+        {
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          const Key & key = QList<Key>::at(index);
+          assign(key, std::move(value));
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return key;
+        }
+
+        //the value at index, which must be valid
+        const T & at(int index) const
+        {
+          countLookup();
+          return QMap<Key,T>::constFind(QList<Key>::at(index)).value();
+        }
+
+        T & atRef(int index) { return QMap<Key,T>::find(QList<Key>::at(index)).value(); }
+
+        T value(int index) const
+        {
+           Key key = QList<Key>::value(index);
+           return  QMap<Key,T>::value(key);
+        }
+
+        int remove(const Key &key)
+        {
+           const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+           //QMap::remove() detaches even for a missing key
+           int i = keyOrder(key);
+           if (i < 0)
+             return -1;
+           removeKeyAt(i);
+           QMap<Key,T>::remove(key);
+           countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+           return i;
+        }
+
+        Key removeAt(int i)
+        {
+            const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+            Key key = this->key(i);
+            removeKeyAt(i);
+            QMap<Key,T>::remove(key);
+            countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+            return key;
+        }
+
+        Key removeLast()
+        {
+            Key key = QList<Key>::last();
+            this->remove(key);
+            return key;
+        }
+
+        QPair<Key, T> last() const
+        {
+           if(QList<Key>::isEmpty())
+             return QPair<Key, T>();
+           const Key & key = QList<Key>::last();
+           return QPair<Key, T>(key, QMap<Key,T>::constFind(key).value());
+        }
+
+        bool isEmpty() const
+        { return QMap<Key,T>::isEmpty(); }
+
+        //overrides QList value methods
+        const T value(Key & key) const
+        { return QMap<Key,T>::value(key, T()); }
+
+        const T value(Key & key, const T & defaultValue) const
+        { return QMap<Key,T>::value(key, defaultValue); }
+
+        //overrides QMap value methods
+        const T value(const Key & key) const
+        { return value(key, T()); }
+
+        const T value(const Key & key, const T & defaultValue) const
+        {
+          countLookup();
+          return QMap<Key,T>::value(key, defaultValue);
+        }
+
+        //pointer to the value of key, or nullptr; valid until the map is changed
+        const T * findValue(const Key & key) const
+        {
+          countLookup();
+          typename QMap<Key,T>::const_iterator it = QMap<Key,T>::constFind(key);
+          return it == QMap<Key,T>::constEnd() ? nullptr : &it.value();
+        }
+
+        T * findValue(const Key & key)
+        {
+          countLookup();
+          typename QMap<Key,T>::iterator it = QMap<Key,T>::find(key);
+          return it == QMap<Key,T>::end() ? nullptr : &it.value();
+        }
+
+        //the value of key converted to V, e.g. map.valueAs<int>("timeout", 30), without copying the stored
+        //value first (see OrderedQMapValueCast)
+        template <class V> V valueAs(const Key & key, const V & defaultValue = V()) const
+        {
+          const T * v = findValue(key);
+          return v ? OrderedQMapValueCast<T>::convert(*v, defaultValue) : defaultValue;
+        }
+
+        //the value at index, which must be valid, converted to V
+        template <class V> V atAs(int index, const V & defaultValue = V()) const
+        { return OrderedQMapValueCast<T>::convert(at(index), defaultValue); }
+
+        //the value at a path of keys through nested maps, e.g. "server/tls/port", or nullptr.
+        //For QVariant values: every value on the way must hold a QVariantOrderedQMap (what fromJson()
+        //nests, whatever the policy of this map) or a QVariantMap, and is read in place.
+        //The segments are raw QStrings on the characters of path, so no key is copied; the walk
+        //allocates at most one small string header
+        const T * findAtPath(const QString & path, QChar separator = QLatin1Char('/')) const
+        {
+          typedef OrderedQMap<Key, T> NestedMap;
+          const NestedMap * map = nullptr;
+          const QVariantMap * variantMap = nullptr;
+          QString key;
+          for (int start = 0;;)
+          {
+            const int end = path.indexOf(separator, start);
+            key.setRawData(path.constData() + start, (end < 0 ? path.size() : end) - start);
+            const T * v = nullptr;
+            if (start == 0)
+              v = findValue(key);
+            else if (map)
+              v = map->findValue(key);
+            else
+            {
+              QVariantMap::const_iterator it = variantMap->constFind(key);
+              v = it == variantMap->constEnd() ? nullptr : &it.value();
+            }
+            if (!v || end < 0)
+              return v;
+            map = nullptr;
+            variantMap = nullptr;
+            if (v->userType() == qMetaTypeId<NestedMap>())
+              map = static_cast<const NestedMap *>(v->constData());
+            else if (v->userType() == qMetaTypeId<QVariantMap>())
+              variantMap = static_cast<const QVariantMap *>(v->constData());
+            else
+              return nullptr;
+            start = end + 1;
+          }
+        }
+
+        //copies only the value at the end of the path
+        T valueAtPath(const QString & path, const T & defaultValue = T(), QChar separator = QLatin1Char('/')) const
+        {
+          const T * v = findAtPath(path, separator);
+          return v ? *v : defaultValue;
+        }
+
+        //case (in)sensitive value lookup, O(1) with the CaseInsensitiveKeys policy
+        const T value(const QString & key, Qt::CaseSensitivity cs, const T & defaultValue = T()) const
+        {
+          if (cs == Qt::CaseSensitive)
+            return value(key, defaultValue);
+          countLookup();
+          const Key * k = findKey(key);
+          return k ? QMap<Key,T>::value(*k, defaultValue) : defaultValue;
+        }
+
+        //lookups by QStringView, QLatin1String or UTF-8 const char*, e.g. map.value("literal");
+        //with the StringViewKeys policy they go through the folded index and build no QString
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, bool>::type
+        contains(View key, Qt::CaseSensitivity cs = Qt::CaseSensitive) const
+        {
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key, cs) != nullptr;
+          return contains(OrderedQMapStringView<View>::toString(key), cs);
+        }
+
+        //findValue() by a QStringView, e.g. a part of a longer string; without the StringViewKeys
+        //policy the lookup key is a raw QString on the characters of key, which are not copied
+        const T * findValue(QStringView key) const
+        {
+          if (!KeyPolicy::CaseFoldedIndex)
+            return findValue(QString::fromRawData(key.data(), int(key.size())));
+          countLookup();
+          const Key * k = m_foldedKeys.find(key, Qt::CaseSensitive);
+          return k ? &QMap<Key,T>::constFind(*k).value() : nullptr;
+        }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        value(View key, const T & defaultValue = T()) const
+        { return value(key, Qt::CaseSensitive, defaultValue); }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        value(View key, Qt::CaseSensitivity cs, const T & defaultValue = T()) const
+        {
+          if (!KeyPolicy::CaseFoldedIndex)
+            return value(OrderedQMapStringView<View>::toString(key), cs, defaultValue);
+          const Key * k = m_foldedKeys.find(key, cs);
+          return k ? QMap<Key,T>::constFind(*k).value() : defaultValue;
+        }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        operator[](View key) const { return value(key); }
+
+        //only builds a QString key when key is not in the map yet
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, T &>::type
+        operator[](View key)
+        {
+          const Key * k = KeyPolicy::CaseFoldedIndex ? m_foldedKeys.find(key, Qt::CaseSensitive) : nullptr;
+          if (k)
+            return QMap<Key,T>::find(*k).value();
+          return operator[](OrderedQMapStringView<View>::toString(key));
+        }
+
+        QMap<Key, T> toQMap() { return *this; }
+
+        QList<T> values() const
+        {
+          QVector<const T *> ordered = orderedValues();
+          QList<T> res;
+          res.reserve(ordered.size());
+          for (const T * v : ordered)
+            res.append(v ? *v : T());
+          return res;
+        }
+
+        QList<QPair<T, Key> > valueKeyList(bool addEmptyPair = false, bool putEmptyPairAsFirst = true) const
+        {
+          QVector<const T *> ordered = orderedValues();
+          QList<QPair<T, Key> > res;
+          res.reserve(ordered.size() + 1);
+          if (addEmptyPair && putEmptyPairAsFirst)
+            res.append(qMakePair(T(), Key()));
+          for (int i = 0; i < ordered.size(); ++i)
+            res.append(qMakePair(ordered.at(i) ? *ordered.at(i) : T(), QList<Key>::at(i)));
+          if (addEmptyPair && !putEmptyPairAsFirst)
+            res.append(qMakePair(T(), Key()));
+          return res;
+        }
+
+        Key key(int index) const { return QList<Key>::value(index);}
+
+        int size() const { return QMap<Key,T>::size(); }
+
+        int count(const Key &key) const { return QMap<Key,T>::count(key); }
+
+        int length() const { return QMap<Key, T>::size(); }
+
+        QList<Key> keys() const { return *this; }
+
+        int keyOrder(const Key &key) const
+        {
+            countLookup();
+            typename QHash<Key, int>::const_iterator it = m_keyIndex.constFind(key);
+            return it == m_keyIndex.constEnd() ? -1 : it.value() - m_indexBase;
+        }
+
+        void clear()
+        {
+           QMap<Key,T>::clear();
+           QList<Key>::clear();
+           m_keyIndex.clear();
+           m_indexBase = 0;
+           m_foldedKeys.clear();
+        }
+
+        //moves the key at position from to position to, shifting the keys in between; O(|to - from|)
+        void move(int from, int to)
+        {
+          if (from == to)
+            return;
+          QList<Key>::move(from, to);
+          renumberKeys(qMin(from, to), qMax(from, to));
+        }
+
+        //exchanges the positions of the keys at i and j
+        void swapAt(int i, int j)
+        {
+          if (i == j)
+            return;
+          std::swap(QList<Key>::operator[](i), QList<Key>::operator[](j));
+          m_keyIndex[QList<Key>::at(i)] = m_indexBase + i;
+          m_keyIndex[QList<Key>::at(j)] = m_indexBase + j;
+        }
+
+        //returns false when key is not present
+        bool moveToFront(const Key & key)
+        {
+          int i = keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, 0);
+          return true;
+        }
+
+        bool moveToBack(const Key & key)
+        {
+          int i = keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, QList<Key>::size() - 1);
+          return true;
+        }
+
+        //stable sort of the insertion order by value, lessThan(const T &, const T &);
+        //the values are neither copied nor moved. A key without a value, which only an index out of sync
+        //with the map can produce, is sorted as T() instead of being dereferenced
+        template <class LessThan> void sortOrder(LessThan lessThan)
+        {
+          QVector<const T *> values = orderedValues();
+          Q_ASSERT_X(!values.contains(nullptr), "OrderedQMap::sortOrder", "key index out of sync with the map");
+          const T missing = T();
+          QVector<int> order(values.size());
+          for (int i = 0; i < order.size(); ++i)
+            order[i] = i;
+          std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return lessThan(values.at(a) ? *values.at(a) : missing, values.at(b) ? *values.at(b) : missing);
+          });
+          sortKeys(order);
+        }
+
+        //stable sort of the insertion order by key, lessThan(const Key &, const Key &)
+        template <class LessThan> void sortOrderByKey(LessThan lessThan)
+        {
+          QVector<int> order(QList<Key>::size());
+          for (int i = 0; i < order.size(); ++i)
+            order[i] = i;
+          std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return lessThan(QList<Key>::at(a), QList<Key>::at(b)); });
+          sortKeys(order);
+        }
+
+        //O(1), exchanges the contents together with the key indexes
+        void swap(OrderedQMap & other)
+        {
+          QMap<Key,T>::swap(other);
+          QList<Key>::swap(other);
+          m_keyIndex.swap(other.m_keyIndex);
+          qSwap(m_indexBase, other.m_indexBase);
+          qSwap(m_foldedKeys, other.m_foldedKeys);
+        }
+
+        //removes key and returns its value moved out of the map, or T() when key is not present
+        T take(const Key & key)
+        {
+          typename QMap<Key, T>::iterator iter = QMap<Key,T>::find(key);
+          if (iter == QMap<Key,T>::end())
+            return T();
+          T value = std::move(iter.value());
+          removeKeyAt(keyOrder(iter.key()));
+          QMap<Key,T>::erase(iter);
+          return value;
+        }
+
+        //overrides QMap::erase; returns the iterator following it in QMap order
+        typename QMap<Key, T>::iterator erase(typename QMap<Key, T>::iterator it)
+        {
+          removeKeyAt(keyOrder(it.key()));
+          return QMap<Key,T>::erase(it);
+        }
+
+        //returns the iterator to the entry that followed it in insertion order
+        ordered_iterator erase(ordered_iterator it)
+        {
+          removeAt(it.index());
+          return it;
+        }
+
+        enum MergePolicy
+        {
+          OverwriteExisting, //values of other replace those of present keys, which keep their position
+          KeepExisting,      //present keys keep their value, only the new keys of other are added
+          MoveToBack         //like OverwriteExisting, but all keys of other end up at the back in other's order
+        };
+
+        //adds the entries of other in its insertion order, in one pass over other with the index presized;
+        //new keys are appended. Merging into an empty map only shares other's data
+        OrderedQMap & merge(const OrderedQMap & other, MergePolicy policy = OverwriteExisting)
+        {
+          if (&other == this || other.isEmpty())
+            return *this;
+          if (isEmpty())
+          {
+            *this = other;
+            return *this;
+          }
+          const int shared = sharedParts(static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          QVector<const T *> values = other.orderedValues();
+          reserve(QList<Key>::size() + values.size());
+          if (policy == MoveToBack)
+          {
+            QList<Key> keys;
+            keys.reserve(QList<Key>::size() + values.size());
+            for (const Key & k : static_cast<const QList<Key> &>(*this))
+              if (!other.m_keyIndex.contains(k))
+                keys.append(k);
+            for (int i = 0; i < values.size(); ++i)
+            {
+              const Key & k = other.QList<Key>::at(i);
+              if (!m_keyIndex.contains(k))
+              {
+                m_foldedKeys.insert(k);
+                countInsert();
+              }
+              QMap<Key,T>::insert(k, *values.at(i));
+              keys.append(k);
+            }
+            QList<Key>::swap(keys);
+            reindexKeys();
+            countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+            return *this;
+          }
+          for (int i = 0; i < values.size(); ++i)
+          {
+            const Key & k = other.QList<Key>::at(i);
+            if (policy == KeepExisting && m_keyIndex.contains(k))
+              continue;
+            QMap<Key,T>::insert(k, *values.at(i));
+            appendKey(k);
+          }
+          countDetach(shared, static_cast<const QMap<Key,T> &>(*this), static_cast<const QList<Key> &>(*this));
+          return *this;
+        }
+
+        //keys stay unique: unlike QMap::unite, a key present in both maps gets the value of other
+        OrderedQMap & unite(const OrderedQMap & other) { return merge(other, OverwriteExisting); }
+
+        OrderedQMap& operator()(const Key & key, const T & value)
+        {
+            insert(key, value);
+            return *this;
+        }
+
+        OrderedQMap& operator()(const Key & key, T && value)
+        {
+            insert(key, std::move(value));
+            return *this;
+        }
+
+        OrderedQMap &operator<< (const QPair<Key,T> &t)
+        {
+          this->insert(t.first, t.second);
+          return *this;
+        }
+
+        OrderedQMap &operator<< (QPair<Key,T> &&t)
+        {
+          this->insert(t.first, std::move(t.second));
+          return *this;
+        }
+
+        OrderedQMap &operator>> (const QPair<Key,T> &t)
+        {
+          this->prepend(t.first, t.second);
+          return *this;
+        }
+
+        //writes every entry once, in insertion order (see OrderedQMapStream)
+        friend QDataStream &operator <<(QDataStream &out, const OrderedQMap &obj)
+        {
+          const qint64 start = obj.streamPos(out);
+          QVector<const T *> ordered = obj.orderedValues();
+          OrderedQMapStream::writeHeader(out, ordered.size());
+          for (int i = 0; i < ordered.size(); ++i)
+            out << obj.QList<Key>::at(i) << (ordered.at(i) ? *ordered.at(i) : T());
+          obj.countSerialized(out, start);
+          return out;
+        }
+
+        //reads the current and the legacy stream format
+        friend QDataStream &operator >>(QDataStream &in, OrderedQMap &obj)
+        {
+          qint32 count = 0;
+          bool legacy = false;
+          if (!OrderedQMapStream::readHeader(in, count, legacy))
+            return in;
+          if (legacy)
+          {
+            OrderedQMapStream::readLegacy<Key, T>(in, count, obj);
+            return in;
+          }
+          obj.QList<Key>::reserve(obj.QList<Key>::size() + OrderedQMapStream::reservation(count));
+          obj.m_keyIndex.reserve(obj.m_keyIndex.size() + OrderedQMapStream::reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Key k;
+            T v;
+            in >> k >> v;
+            if (in.status() != QDataStream::Ok)
+              break;
+            obj.insert(k, std::move(v));
+          }
+          return in;
+        }
+
+    private:
+        friend struct OrderedQMapParallel;
+
+        // key -> order number of that key in the QList<Key> base.
+        // Positions are stored relative to m_indexBase, so prepending a key or removing
+        // the first one only moves the base instead of renumbering every other key.
+        QHash<Key, int> m_keyIndex;
+        int m_indexBase = 0;
+        OrderedQMapFoldedIndex<Key, KeyPolicy::CaseFoldedIndex> m_foldedKeys;
+
+        //moves value into the map; Qt's QMap::insert only takes a const reference and would copy it
+        typename QMap<Key, T>::iterator assign(const Key & key, T && value)
+        {
+          typename QMap<Key, T>::iterator iter = QMap<Key,T>::find(key);
+          if (iter == QMap<Key,T>::end())
+            iter = QMap<Key,T>::insert(key, T());
+          *iter = std::move(value);
+          return iter;
+        }
+
+        //the stored key equal to key ignoring case, or nullptr
+        const Key * findKey(const QString & key) const
+        {
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key);
+          int probes = 0;
+          for (const Key & k : static_cast<const QList<Key> &>(*this))
+          {
+            ++probes;
+            if (key.compare(k, Qt::CaseInsensitive) == 0)
+            {
+              countScan(probes);
+              return &k;
+            }
+          }
+          countScan(probes);
+          return nullptr;
+        }
+
+        //pointers to the values in insertion order, collected in one pass over the QMap.
+        //The n-th entry of the QMap lands at position n without a lookup while the order list has the
+        //same key there, i.e. for every key inserted in ascending order; any other key costs one hash
+        //lookup in the key index (not counted by the statistics) and the result is a temporary vector.
+        //The values stay in the QMap, so one lookup per reordered key is the price of that layout.
+        QVector<const T *> orderedValues() const
+        {
+          const QList<Key> & order = *this;
+          QVector<const T *> res(order.size(), nullptr);
+          int n = 0;
+          for (typename QMap<Key,T>::const_iterator it = QMap<Key,T>::constBegin(); it != QMap<Key,T>::constEnd(); ++it, ++n)
+          {
+            if (n < order.size() && order.at(n) == it.key())
+            {
+              res[n] = &it.value();
+              continue;
+            }
+            typename QHash<Key, int>::const_iterator i = m_keyIndex.constFind(it.key());
+            if (i != m_keyIndex.constEnd())
+              res[i.value() - m_indexBase] = &it.value();
+          }
+          return res;
+        }
+
+        //a single hash lookup: operator[] only grows the index when key is new
+        void appendKey(const Key & key)
+        {
+          const int known = m_keyIndex.size();
+          const int capacity = capacityOf(m_keyIndex);
+          int & index = m_keyIndex[key];
+          if (m_keyIndex.size() == known)
+            return;
+          index = m_indexBase + QList<Key>::size();
+          m_foldedKeys.insert(key);
+          QList<Key>::append(key);
+          countInsert();
+          countReallocation(m_keyIndex, capacity);
+        }
+
+        template <class InputIterator> void reserveRange(InputIterator, InputIterator, std::input_iterator_tag) {}
+
+        template <class ForwardIterator> void reserveRange(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+        { reserve(QList<Key>::size() + int(std::distance(first, last))); }
+
+        void prependKey(const Key & key)
+        {
+          if (m_keyIndex.contains(key))
+            return;
+          if (m_indexBase < std::numeric_limits<int>::min() / 2)
+            reindexKeys();
+          const int capacity = capacityOf(m_keyIndex);
+          m_keyIndex.insert(key, --m_indexBase);
+          m_foldedKeys.insert(key);
+          QList<Key>::prepend(key);
+          countInsert();
+          countReallocation(m_keyIndex, capacity);
+        }
+
+        //removes the key at position i, renumbering whichever side of i is shorter
+        void removeKeyAt(int i)
+        {
+          const int n = QList<Key>::size();
+          m_keyIndex.remove(QList<Key>::at(i));
+          m_foldedKeys.remove(QList<Key>::at(i));
+          if (i < n / 2)
+          {
+            for (int j = 0; j < i; ++j)
+              ++m_keyIndex[QList<Key>::at(j)];
+            ++m_indexBase;
+          }
+          else
+          {
+            for (int j = i + 1; j < n; ++j)
+              --m_keyIndex[QList<Key>::at(j)];
+          }
+          QList<Key>::removeAt(i);
+          if (m_indexBase > std::numeric_limits<int>::max() / 2)
+            reindexKeys();
+        }
+
+        void reindexKeys()
+        {
+          m_indexBase = 0;
+          for (int j = 0; j < QList<Key>::size(); ++j)
+            m_keyIndex[QList<Key>::at(j)] = j;
+        }
+
+        //renumbers the keys at positions first to last after they were rearranged
+        void renumberKeys(int first, int last)
+        {
+          for (int j = first; j <= last; ++j)
+            m_keyIndex[QList<Key>::at(j)] = m_indexBase + j;
+        }
+
+        //puts the keys in order, order[i] being the old position of the new i-th key
+        void sortKeys(const QVector<int> & order)
+        {
+          QList<Key> keys;
+          keys.reserve(order.size());
+          for (int i = 0; i < order.size(); ++i)
+            keys.append(QList<Key>::at(order.at(i)));
+          QList<Key>::swap(keys);
+          reindexKeys();
+        }
+
+    };
+
+    //ordered QMultiMap; Container is QMultiMap or QMultiHash, OrderedQMultiHash is this class on a QMultiHash.
+    //Both keep the values of a key newest first, so the n-th occurrence of a key holds the n-th value counted
+    //from the end of its values
+    template <class Key, class T, class KeyPolicy = CaseSensitiveKeys, template <class, class> class Container = QMultiMap>
+    class OrderedQMultiMap : public Container<Key,T>, private QList<Key>
+    {
+        //ToDo
+        // Do not use write functions of QList until they are not implemented here.
+
+    public:
+        OrderedQMultiMap() {}
+
+        //inserts every pair in list order, a repeated key adds another value
+        OrderedQMultiMap(std::initializer_list<QPair<Key,T> > list) { insertRange(list.begin(), list.end()); }
+
+        typename Container<Key,T>::iterator begin() { return Container<Key,T>::begin(); }
+
+        typename Container<Key,T>::const_iterator begin() const { return Container<Key,T>::begin(); }
+
+        typename Container<Key,T>::iterator end() { return Container<Key,T>::end(); }
+
+        typename Container<Key,T>::const_iterator end() const { return Container<Key,T>::end(); }
+
+        //preallocates the order list for n key occurrences in total
+        void reserve(int n) { QList<Key>::reserve(n); }
+
+        //O(1), exchanges the contents
+        void swap(OrderedQMultiMap & other)
+        {
+          Container<Key,T>::swap(other);
+          QList<Key>::swap(other);
+          m_occurrences.swap(other.m_occurrences);
+          qSwap(m_indexBase, other.m_indexBase);
+          qSwap(m_foldedKeys, other.m_foldedKeys);
+        }
+
+        //appends every key occurrence of other with its value, in other's insertion order
+        OrderedQMultiMap & unite(const OrderedQMultiMap & other)
+        {
+          if (&other == this)
+            return unite(OrderedQMultiMap(other));
+          const QList<Key> & keys = other;
+          QVector<const T *> values = occurrenceValues(keys, other);
+          reserve(QList<Key>::size() + keys.size());
+          for (int i = 0; i < keys.size(); ++i)
+            insert(keys.at(i), values.at(i) ? *values.at(i) : T());
+          return *this;
+        }
+
+        template <class InputIterator> void insertRange(InputIterator first, InputIterator last)
+        {
+          for (; first != last; ++first)
+            insert((*first).first, (*first).second);
+        }
+
+        //overrides QList::contains method, O(1) lookup in the occurrence index
+        bool contains(const Key & key) const { return m_occurrences.contains(key); }
+
+        //introduces case (in)sensitive contains lije QStringList has.
+        //O(1) when case sensitive, and for QString keys with the CaseInsensitiveKeys policy;
+        //otherwise one pass over the distinct keys of the occurrence index
+        bool contains(const Key & key, Qt::CaseSensitivity cs) const
+        {
+          if (cs == Qt::CaseSensitive)
+            return contains(key);
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key) != nullptr;
+          const QString strKey = QVariant(key).toString();
+          for (typename QHash<Key, QVector<int> >::const_iterator it = m_occurrences.constBegin(); it != m_occurrences.constEnd(); ++it)
+            if (strKey.compare(QVariant(it.key()).toString(), cs) == 0)
+              return true;
+          return false;
+        }
+
+        //overrides QList::operator method
+        const T operator[](Key & key) const { return Container<Key,T>::value(key); }
+
+        T & operator[](Key & key)
+        {
+          indexKey(key);
+          if (!m_occurrences.contains(key))
+            appendOccurrence(key);
+          return Container<Key,T>::operator [](key);
+        }
+
+        //overrides QMultiMap::operator / QMultiHash::operator method
+        const T operator[](const Key & key) const { return Container<Key,T>::value(key); }
+
+        T & operator[](const Key & key)
+        {
+          indexKey(key);
+          if (!m_occurrences.contains(key))
+            appendOccurrence(key);
+          return Container<Key,T>::operator [](key);
+        }
+
+        typename Container<Key, T>::iterator insert(const Key & key, const T & value)
+        {
+          indexKey(key);
+          typename Container<Key, T>::iterator iter = Container<Key,T>::insert(key, value);
+          appendOccurrence(key);
+          return iter;
+        }
+
+        //moves value in; Qt's insert only takes a const reference and would copy it
+        typename Container<Key, T>::iterator insert(const Key & key, T && value)
+        {
+          typename Container<Key, T>::iterator iter = insert(key, static_cast<const T &>(T()));
+          *iter = std::move(value);
+          return iter;
+        }
+
+        typename Container<Key, T>::iterator append(const Key & key, const T & value) { return insert(key, value); }
+
+        typename Container<Key, T>::iterator append(const Key & key, T && value) { return insert(key, std::move(value)); }
+
+        template <class... Args> typename Container<Key, T>::iterator emplace(const Key & key, Args &&... args)
+        { return insert(key, T(std::forward<Args>(args)...)); }
+
+        //adds an occurrence of key in front of all others; its value becomes the oldest value of key,
+        //so a present key has its k values reinserted: O(k log n) on a QMultiMap, O(k) on a QMultiHash
+        typename Container<Key, T>::iterator prepend(const Key & key, const T & value)
+        {
+          indexKey(key);
+          if (!m_occurrences.contains(key))
+          {
+            typename Container<Key, T>::iterator iter = Container<Key,T>::insert(key, value);
+            prependOccurrence(key);
+            return iter;
+          }
+          QList<T> newer = Container<Key,T>::values(key);
+          Container<Key,T>::remove(key);
+          Container<Key,T>::insert(key, value);
+          for (int i = newer.size() - 1; i >= 0; --i)
+            Container<Key,T>::insert(key, newer.at(i));
+          prependOccurrence(key);
+          return valueAt(key, 0);
+        }
+
+        typename Container<Key, T>::iterator prepend(const Key & key, T && value)
+        {
+          typename Container<Key, T>::iterator iter = prepend(key, static_cast<const T &>(T()));
+          *iter = std::move(value);
+          return iter;
+        }
+
+        typename Container<Key, T>::iterator replace(const Key & key, const T & value)
+        {
+          indexKey(key);
+          if (!m_occurrences.contains(key))
+            appendOccurrence(key);
+          typename Container<Key, T>::iterator iter = Container<Key,T>::replace(key, value);
+          return iter;
+        }
+
+        typename Container<Key, T>::iterator find(const Key & key) { return Container<Key,T>::find(key); }
+
+        typename Container<Key, T>::const_iterator find(const Key & key) const { return Container<Key,T>::constFind(key); }
+
+        //removes every occurrence of key in one pass over the order list; a key with a single
+        //occurrence only renumbers the shorter side of it
+        int remove(const Key &key)
+        {
+          typename QHash<Key, QVector<int> >::iterator chain = m_occurrences.find(key);
+          if (chain == m_occurrences.end())
+            return 0;
+          if (chain.value().size() == 1)
+          {
+            removeEntryAt(chain.value().first() - m_indexBase);
+            return 1;
+          }
+          const Key removed = key;
+          m_occurrences.erase(chain);
+          QList<Key> keys;
+          keys.reserve(QList<Key>::size());
+          for (const Key & k : static_cast<const QList<Key> &>(*this))
+            if (!(k == removed))
+              keys.append(k);
+          QList<Key>::swap(keys);
+          reindexOccurrences();
+          m_foldedKeys.remove(removed);
+          return Container<Key,T>::remove(removed);
+        }
+
+        //removes the i-th occurrence together with its value
+        Key removeAt(int i)
+        {
+          Key key = QList<Key>::at(i);
+          removeEntryAt(i);
+          return key;
+        }
+
+        //removes the oldest occurrence of key that has value; false when there is none
+        bool removeOne(const Key & key, const T & value)
+        {
+          typename QHash<Key, QVector<int> >::const_iterator chain = m_occurrences.constFind(key);
+          if (chain == m_occurrences.constEnd())
+            return false;
+          int rank = oldestRankOf(key, value);
+          if (rank < 0)
+            return false;
+          removeEntryAt(chain.value().at(rank) - m_indexBase);
+          return true;
+        }
+
+        //removes the newest value of key, the one value(key) returns, with its occurrence
+        T take(const Key & key)
+        {
+          typename QHash<Key, QVector<int> >::const_iterator chain = m_occurrences.constFind(key);
+          if (chain == m_occurrences.constEnd())
+            return T();
+          return removeEntryAt(chain.value().last() - m_indexBase);
+        }
+
+        //overrides the erase of the container; returns the iterator following it in the container's order
+        typename Container<Key, T>::iterator erase(typename Container<Key, T>::iterator it)
+        {
+          typename Container<Key, T>::iterator next = it;
+          ++next;
+          int rank = 0;
+          for (typename Container<Key, T>::iterator older = next; older != Container<Key,T>::end() && older.key() == it.key(); ++older)
+            ++rank;
+          removeEntryAt(m_occurrences.value(it.key()).at(rank) - m_indexBase);
+          return next;
+        }
+
+        //the value of the i-th occurrence, which must be valid; a lookup of the key and a walk over its k values,
+        //O(log n + k) on a QMultiMap, O(k) on a QMultiHash
+        const T & at(int i) const
+        {
+          const Key & key = QList<Key>::at(i);
+          return valueAt(key, rankOf(m_occurrences.constFind(key).value(), i)).value();
+        }
+
+        //the values of key in the order of its occurrences, oldest first
+        QList<T> valuesInOrder(const Key & key) const
+        {
+          QList<T> res = Container<Key,T>::values(key);
+          std::reverse(res.begin(), res.end());
+          return res;
+        }
+
+        //the value of the last inserted occurrence
+        T last() const
+        {
+           if(QList<Key>::isEmpty())
+              return T();
+           return at(QList<Key>::size() - 1);
+        }
+
+        bool isEmpty() const { return Container<Key,T>::isEmpty(); }
+
+        //overrides QList value methods
+        const T value(Key & key) const { return Container<Key,T>::value(key, T()); }
+
+        const T value(Key & key, const T & defaultValue) const { return Container<Key,T>::value(key, defaultValue); }
+
+        //overrides the value methods of the container
+        const T value(const Key & key) const { return Container<Key,T>::value(key, T()); }
+
+        const T value(const Key & key, const T & defaultValue) const { return Container<Key,T>::value(key, defaultValue); }
+
+        Key key(int index) const { return QList<Key>::value(index); }
+
+        int size() const { return Container<Key,T>::size(); }
+
+        int count(const Key &key) const { return Container<Key,T>::count(key); }
+
+        int length() const { return Container<Key, T>::size(); }
+
+        QList<Key> keys() const {return *this;}
+
+        void clear()
+        {
+           Container<Key,T>::clear();
+           QList<Key>::clear();
+           m_occurrences.clear();
+           m_indexBase = 0;
+           m_foldedKeys.clear();
+        }
+
+        OrderedQMultiMap& operator()(const Key & key, const T & value)
+        {
+            insert(key, value);
+            return *this;
+        }
+
+
+        OrderedQMultiMap &operator<< (const QPair<Key,T> &t)
+        {
+          this->insert(t.first, t.second);
+          return *this;
+        }
+
+        //writes every (key, value) occurrence once, in insertion order (see OrderedQMapStream)
+        friend QDataStream &operator <<(QDataStream &out, const OrderedQMultiMap &obj)
+        {
+          const QList<Key> & keys = obj;
+          QVector<const T *> values = occurrenceValues(keys, obj);
+          OrderedQMapStream::writeHeader(out, keys.size());
+          for (int i = 0; i < keys.size(); ++i)
+            out << keys.at(i) << (values.at(i) ? *values.at(i) : T());
+          return out;
+        }
+
+        //reads the current and, into a QMultiMap, the legacy stream format
+        friend QDataStream &operator >>(QDataStream &in, OrderedQMultiMap &obj)
+        {
+          qint32 count = 0;
+          bool legacy = false;
+          if (!OrderedQMapStream::readHeader(in, count, legacy))
+            return in;
+          if (legacy)
+          {
+            readLegacy(in, count, obj, obj);
+            return in;
+          }
+          obj.QList<Key>::reserve(obj.QList<Key>::size() + OrderedQMapStream::reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Key k;
+            T v;
+            in >> k >> v;
+            if (in.status() != QDataStream::Ok)
+              break;
+            obj.insert(k, std::move(v));
+          }
+          return in;
+        }
+
+        //the QMultiMap or QMultiHash the map is built on; toQMap() and toQHash() are the same
+        Container<Key,T> toQMap() { return *this; }
+
+        Container<Key,T> toQHash() { return *this; }
+
+    private:
+        // key -> ascending positions of its occurrences in the QList<Key> base, relative to m_indexBase
+        // like OrderedQMap's key index. The n-th occurrence of a key holds the n-th oldest of its values.
+        QHash<Key, QVector<int> > m_occurrences;
+        int m_indexBase = 0;
+        OrderedQMapFoldedIndex<Key, KeyPolicy::CaseFoldedIndex> m_foldedKeys;
+
+        //adds a key that is not in the map yet to the case-folded index
+        void indexKey(const Key & key)
+        {
+          if (KeyPolicy::CaseFoldedIndex && !m_occurrences.contains(key))
+            m_foldedKeys.insert(key);
+        }
+
+        void appendOccurrence(const Key & key)
+        {
+          m_occurrences[key].append(m_indexBase + QList<Key>::size());
+          QList<Key>::append(key);
+        }
+
+        void prependOccurrence(const Key & key)
+        {
+          if (m_indexBase < std::numeric_limits<int>::min() / 2)
+            reindexOccurrences();
+          m_occurrences[key].prepend(--m_indexBase);
+          QList<Key>::prepend(key);
+        }
+
+        //rank of the occurrence at position i among the occurrences of its key, 0 being the oldest
+        int rankOf(const QVector<int> & chain, int i) const
+        { return int(std::lower_bound(chain.constBegin(), chain.constEnd(), m_indexBase + i) - chain.constBegin()); }
+
+        //the chain entry of the occurrence at position i
+        int & occurrence(int i)
+        {
+          QVector<int> & chain = m_occurrences[QList<Key>::at(i)];
+          return chain[rankOf(chain, i)];
+        }
+
+        //removes the occurrence at position i and its value, renumbering whichever side of i is shorter
+        T removeEntryAt(int i)
+        {
+          const Key key = QList<Key>::at(i);
+          typename QHash<Key, QVector<int> >::iterator chain = m_occurrences.find(key);
+          const int rank = rankOf(chain.value(), i);
+          typename Container<Key, T>::iterator it = valueAt(key, rank);
+          T value = std::move(it.value());
+          Container<Key,T>::erase(it);
+          chain.value().remove(rank);
+          if (chain.value().isEmpty())
+          {
+            m_occurrences.erase(chain);
+            m_foldedKeys.remove(key);
+          }
+          const int n = QList<Key>::size();
+          //walks away from i, so a renumbered position never equals one still to be looked up
+          if (i < n / 2)
+          {
+            for (int j = i - 1; j >= 0; --j)
+              ++occurrence(j);
+            ++m_indexBase;
+          }
+          else
+          {
+            for (int j = i + 1; j < n; ++j)
+              --occurrence(j);
+          }
+          QList<Key>::removeAt(i);
+          if (m_indexBase > std::numeric_limits<int>::max() / 2)
+            reindexOccurrences();
+          return value;
+        }
+
+        void reindexOccurrences()
+        {
+          m_indexBase = 0;
+          for (typename QHash<Key, QVector<int> >::iterator it = m_occurrences.begin(); it != m_occurrences.end(); ++it)
+            it.value().resize(0);
+          for (int j = 0; j < QList<Key>::size(); ++j)
+            m_occurrences[QList<Key>::at(j)].append(j);
+        }
+
+        //the value of the rank-th oldest occurrence of key, walking from the newest value of key
+        typename Container<Key, T>::iterator valueAt(const Key & key, int rank)
+        {
+          typename Container<Key, T>::iterator it = Container<Key,T>::find(key);
+          for (int r = m_occurrences.constFind(key).value().size() - 1; r > rank; --r)
+            ++it;
+          return it;
+        }
+
+        typename Container<Key, T>::const_iterator valueAt(const Key & key, int rank) const
+        {
+          typename Container<Key, T>::const_iterator it = Container<Key,T>::constFind(key);
+          for (int r = m_occurrences.constFind(key).value().size() - 1; r > rank; --r)
+            ++it;
+          return it;
+        }
+
+        //rank of the oldest value of key equal to value, or -1
+        int oldestRankOf(const Key & key, const T & value) const
+        {
+          int rank = m_occurrences.constFind(key).value().size() - 1;
+          int res = -1;
+          for (typename Container<Key, T>::const_iterator it = Container<Key,T>::constFind(key); it != Container<Key,T>::constEnd() && it.key() == key; ++it, --rank)
+            if (it.value() == value)
+              res = rank;
+          return res;
+        }
+
+        //the legacy format stored a QMultiMap
+        static void readLegacy(QDataStream & in, qint32 count, OrderedQMultiMap & obj, const QMultiMap<Key,T> &)
+        {
+          QList<Key> keys;
+          QMultiMap<Key, T> tmpMap;
+          if (!OrderedQMapStream::readLegacyKeys(in, count, keys))
+            return;
+          in >> tmpMap;
+          QVector<const T *> values = occurrenceValues(keys, tmpMap);
+          for (int i = 0; i < keys.size(); ++i)
+            obj.insert(keys.at(i), values.at(i) ? *values.at(i) : T());
+        }
+
+        //it never existed for a QMultiHash and is rejected as corrupt
+        static void readLegacy(QDataStream & in, qint32, OrderedQMultiMap &, const QMultiHash<Key,T> &)
+        { in.setStatus(QDataStream::ReadCorruptData); }
+
+        //the value of every key occurrence in keys, in one pass: QMultiMap keeps the values of a key
+        //newest first, so the n-th occurrence of a key gets the n-th value counted from the end of its range
+        static QVector<const T *> occurrenceValues(const QList<Key> & keys, const QMultiMap<Key,T> & map)
+        {
+          typedef typename QMultiMap<Key,T>::const_iterator MapIterator;
+          QHash<Key, MapIterator> next;
+          QVector<const T *> res(keys.size(), nullptr);
+          for (int i = 0; i < keys.size(); ++i)
+          {
+            const Key & k = keys.at(i);
+            typename QHash<Key, MapIterator>::iterator cursor = next.find(k);
+            if (cursor == next.end())
+              cursor = next.insert(k, map.upperBound(k));
+            if (cursor.value() == map.constBegin())
+              continue;
+            MapIterator it = cursor.value();
+            --it;
+            if (!(it.key() == k))
+              continue;
+            res[i] = &it.value();
+            cursor.value() = it;
+          }
+          return res;
+        }
+
+        //a QMultiHash can only be walked forward from the newest value of a key, so the values of a key
+        //are collected once and handed out from the end
+        static QVector<const T *> occurrenceValues(const QList<Key> & keys, const QMultiHash<Key,T> & map)
+        {
+          QHash<Key, QVector<const T *> > pending;
+          QVector<const T *> res(keys.size(), nullptr);
+          for (int i = 0; i < keys.size(); ++i)
+          {
+            const Key & k = keys.at(i);
+            typename QHash<Key, QVector<const T *> >::iterator values = pending.find(k);
+            if (values == pending.end())
+            {
+              values = pending.insert(k, QVector<const T *>());
+              for (typename QMultiHash<Key,T>::const_iterator it = map.constFind(k); it != map.constEnd() && it.key() == k; ++it)
+                values.value().append(&it.value());
+            }
+            if (values.value().isEmpty())
+              continue;
+            res[i] = values.value().last();
+            values.value().removeLast();
+          }
+          return res;
+        }
+
+    };
+
+    //memory arena: allocate() bumps a pointer inside large blocks, so a map costs a few block allocations
+    //instead of one per entry or growth.
+    //A Monotonic arena ignores deallocate(): a map that is built and thrown away never frees anything one
+    //by one, and reset() releases everything at once, when no container uses the arena any more.
+    //A Pooled arena rounds sizes up to powers of two and keeps freed buffers in one free list per size,
+    //so buffers dropped by growing, clearing or destroying a container are reused and the arena only
+    //grows to the peak of what is in use at once. threadArena(), the default of ArenaAllocation, is pooled.
+    //An arena created by the caller is not thread safe and must outlive the containers on it.
+    //threadArena() gives every thread its own, which is shared: the containers on it hold a reference
+    //(ref()/deref()), so it lives until the thread and the last of them are gone, and it takes a lock
+    //in allocate() and deallocate(), uncontended unless a map was handed to another thread.
+    class OrderedQMapArena
+    {
+    public:
+        enum Mode { Monotonic, Pooled };
+
+        explicit OrderedQMapArena(size_t blockSize = 64 * 1024, Mode mode = Monotonic) : OrderedQMapArena(blockSize, mode, false) {}
+
+        ~OrderedQMapArena() { release(); }
+
+        Mode mode() const { return m_mode; }
+
+        //a container starts or stops using the arena; only counted for threadArena(), which deletes
+        //itself with the last reference
+        void ref()
+        {
+          if (m_shared)
+            m_ref.ref();
+        }
+
+        void deref()
+        {
+          if (m_shared && !m_ref.deref())
+            delete this;
+        }
+
+        void *allocate(size_t size, size_t align)
+        {
+          QMutexLocker locker(m_shared ? &m_lock : nullptr);
+          return allocateUnlocked(size, align);
+        }
+
+        //size as passed to allocate(); only a Pooled arena keeps the buffer for reuse
+        void deallocate(void * p, size_t size)
+        {
+          if (m_mode != Pooled || !p)
+            return;
+          QMutexLocker locker(m_shared ? &m_lock : nullptr);
+          deallocateUnlocked(p, size);
+        }
+
+        //frees all blocks but the first one and starts over in it
+        void reset()
+        {
+          QMutexLocker locker(m_shared ? &m_lock : nullptr);
+          std::fill(m_free, m_free + FreeLists, nullptr);
+          if (!m_blocks)
+            return;
+          while (m_blocks->next)
+          {
+            Block * b = m_blocks;
+            m_blocks = b->next;
+            ::operator delete(b);
+          }
+          m_pos = reinterpret_cast<char *>(m_blocks + 1);
+          m_end = m_pos + m_blocks->size;
+          m_allocated = 0;
+        }
+
+        //bytes handed out since construction or the last reset() and not given back to a Pooled arena
+        qint64 bytesAllocated() const { return m_allocated; }
+
+        //pooled arena of the calling thread; the thread holds one reference until it exits
+        static OrderedQMapArena *threadArena()
+        {
+          static thread_local ThreadReference arena(new OrderedQMapArena(64 * 1024, Pooled, true));
+          return arena.arena;
+        }
+
+    private:
+        Q_DISABLE_COPY(OrderedQMapArena)
+
+        enum { FreeLists = sizeof(size_t) * 8 };
+
+        struct Block
+        {
+          Block * next;
+          size_t size;
+        };
+
+        struct FreeBuffer
+        {
+          FreeBuffer * next;
+        };
+
+        struct ThreadReference
+        {
+          explicit ThreadReference(OrderedQMapArena * a) : arena(a) {}
+          ~ThreadReference() { arena->deref(); }
+
+          OrderedQMapArena * arena;
+        };
+
+        Block * m_blocks;
+        char * m_pos;
+        char * m_end;
+        size_t m_blockSize;
+        qint64 m_allocated;
+        Mode m_mode;
+        FreeBuffer * m_free[FreeLists];  //by size class, 2^c bytes
+        bool m_shared;
+        QAtomicInt m_ref;
+        QMutex m_lock;
+
+        OrderedQMapArena(size_t blockSize, Mode mode, bool shared)
+          : m_blocks(nullptr), m_pos(nullptr), m_end(nullptr), m_blockSize(blockSize), m_allocated(0), m_mode(mode), m_free(),
+            m_shared(shared), m_ref(1) {}
+
+        void *allocateUnlocked(size_t size, size_t align)
+        {
+          if (m_mode == Pooled)
+          {
+            const int c = sizeClass(size);
+            size = size_t(1) << c;
+            //a freed buffer is aligned for anything but over-aligned types, which always get a new one
+            if (align <= alignof(std::max_align_t) && m_free[c])
+            {
+              FreeBuffer * f = m_free[c];
+              m_free[c] = f->next;
+              m_allocated += size;
+              return f;
+            }
+            align = qMax(align, alignof(std::max_align_t));
+          }
+          char * p = alignUp(m_pos, align);
+          if (!m_pos || size > size_t(m_end - p))
+          {
+            addBlock(size + align);
+            p = alignUp(m_pos, align);
+          }
+          m_pos = p + size;
+          m_allocated += size;
+          return p;
+        }
+
+        void deallocateUnlocked(void * p, size_t size)
+        {
+          const int c = sizeClass(size);
+          FreeBuffer * f = static_cast<FreeBuffer *>(p);
+          f->next = m_free[c];
+          m_free[c] = f;
+          m_allocated -= qint64(1) << c;
+        }
+
+        //smallest c with 2^c >= size and room for the free list link
+        static int sizeClass(size_t size)
+        {
+          int c = 4;
+          while ((size_t(1) << c) < size)
+            ++c;
+          return c;
+        }
+
+        static char *alignUp(char * p, size_t align) { return reinterpret_cast<char *>((quintptr(p) + align - 1) & ~quintptr(align - 1)); }
+
+        //the new block becomes the current one; the rest of the previous block is not used any more
+        void addBlock(size_t minSize)
+        {
+          size_t size = qMax(m_blockSize, minSize);
+          Block * b = static_cast<Block *>(::operator new(sizeof(Block) + size));
+          b->size = size;
+          b->next = m_blocks;
+          m_blocks = b;
+          m_pos = reinterpret_cast<char *>(b + 1);
+          m_end = m_pos + size;
+        }
+
+        void release()
+        {
+          while (m_blocks)
+          {
+            Block * b = m_blocks;
+            m_blocks = b->next;
+            ::operator delete(b);
+          }
+          m_pos = m_end = nullptr;
+        }
+    };
+
+    //growable array in arena memory with the part of the QVector API CompactOrderedQMap uses.
+    //Copies are deep; a copy constructed one takes the arena of the copying thread, not the source's arena,
+    //which may belong to another thread. Moves take the buffer over together with its arena.
+    template <class T> class OrderedQMapArenaVector
+    {
+    public:
+        OrderedQMapArenaVector() : m_arena(OrderedQMapArena::threadArena()), m_data(nullptr), m_size(0), m_capacity(0) { m_arena->ref(); }
+
+        OrderedQMapArenaVector(const OrderedQMapArenaVector & o) : m_arena(OrderedQMapArena::threadArena()), m_data(nullptr), m_size(0), m_capacity(0)
+        {
+          m_arena->ref();
+          reserve(o.m_size);
+          for (int i = 0; i < o.m_size; ++i)
+            new (m_data + i) T(o.m_data[i]);
+          m_size = o.m_size;
+        }
+
+        //o keeps its arena and is left empty
+        OrderedQMapArenaVector(OrderedQMapArenaVector && o) : m_arena(o.m_arena), m_data(o.m_data), m_size(o.m_size), m_capacity(o.m_capacity)
+        {
+          m_arena->ref();
+          o.m_data = nullptr;
+          o.m_size = 0;
+          o.m_capacity = 0;
+        }
+
+        OrderedQMapArenaVector &operator=(const OrderedQMapArenaVector & o)
+        {
+          if (this != &o)
+          {
+            clear();
+            reserve(o.m_size);
+            for (int i = 0; i < o.m_size; ++i)
+              new (m_data + i) T(o.m_data[i]);
+            m_size = o.m_size;
+          }
+          return *this;
+        }
+
+        //o gets the previous buffer and arena of this one
+        OrderedQMapArenaVector &operator=(OrderedQMapArenaVector && o)
+        {
+          swap(o);
+          return *this;
+        }
+
+        void swap(OrderedQMapArenaVector & o)
+        {
+          std::swap(m_arena, o.m_arena);
+          std::swap(m_data, o.m_data);
+          std::swap(m_size, o.m_size);
+          std::swap(m_capacity, o.m_capacity);
+        }
+
+        ~OrderedQMapArenaVector()
+        {
+          clear();
+          m_arena->deallocate(m_data, sizeof(T) * size_t(m_capacity));
+          m_arena->deref();
+        }
+
+        //only while empty
+        void setArena(OrderedQMapArena * arena)
+        {
+          arena->ref();
+          m_arena->deallocate(m_data, sizeof(T) * size_t(m_capacity));
+          m_arena->deref();
+          m_arena = arena;
+          m_data = nullptr;
+          m_capacity = 0;
+        }
+
+        int size() const { return m_size; }
+
+        bool isEmpty() const { return m_size == 0; }
+
+        const T &at(int i) const { return m_data[i]; }
+
+        T &operator[](int i) { return m_data[i]; }
+
+        const T &last() const { return m_data[m_size - 1]; }
+
+        void reserve(int n)
+        {
+          if (n <= m_capacity)
+            return;
+          T * data = static_cast<T *>(m_arena->allocate(sizeof(T) * size_t(n), alignof(T)));
+          for (int i = 0; i < m_size; ++i)
+          {
+            new (data + i) T(std::move(m_data[i]));
+            m_data[i].~T();
+          }
+          m_arena->deallocate(m_data, sizeof(T) * size_t(m_capacity));
+          m_data = data;
+          m_capacity = n;
+        }
+
+        void append(T && t)
+        {
+          grow();
+          new (m_data + m_size) T(std::move(t));
+          ++m_size;
+        }
+
+        void prepend(T && t)
+        {
+          grow();
+          if (m_size == 0)
+          {
+            new (m_data) T(std::move(t));
+          }
+          else
+          {
+            new (m_data + m_size) T(std::move(m_data[m_size - 1]));
+            for (int i = m_size - 1; i > 0; --i)
+              m_data[i] = std::move(m_data[i - 1]);
+            m_data[0] = std::move(t);
+          }
+          ++m_size;
+        }
+
+        void remove(int i)
+        {
+          for (; i < m_size - 1; ++i)
+            m_data[i] = std::move(m_data[i + 1]);
+          removeLast();
+        }
+
+        void removeLast() { m_data[--m_size].~T(); }
+
+        //shrinks; new elements are default constructed
+        void resize(int n)
+        {
+          while (m_size > n)
+            removeLast();
+          reserve(n);
+          for (; m_size < n; ++m_size)
+            new (m_data + m_size) T();
+        }
+
+        //keeps the memory; O(1) when T is trivially destructible
+        void clear()
+        {
+          if (!std::is_trivially_destructible<T>::value)
+            for (int i = 0; i < m_size; ++i)
+              m_data[i].~T();
+          m_size = 0;
+        }
+
+    private:
+        OrderedQMapArena * m_arena;
+        T * m_data;
+        int m_size;
+        int m_capacity;
+
+        void grow()
+        {
+          if (m_size == m_capacity)
+            reserve(qMax(8, m_capacity * 2));
+        }
+    };
+
+    //open addressing key -> slot hash in arena memory with the part of the QHash<Key, int> API
+    //CompactOrderedQMap uses; linear probing with backward shift deletion, so there are no tombstones.
+    //Copies and moves take their arena like OrderedQMapArenaVector.
+    template <class Key> class OrderedQMapArenaIndex
+    {
+    public:
+        OrderedQMapArenaIndex() : m_arena(OrderedQMapArena::threadArena()), m_buckets(nullptr), m_mask(0), m_size(0) { m_arena->ref(); }
+
+        OrderedQMapArenaIndex(const OrderedQMapArenaIndex & o) : m_arena(OrderedQMapArena::threadArena()), m_buckets(nullptr), m_mask(0), m_size(0)
+        {
+          m_arena->ref();
+          copyFrom(o);
+        }
+
+        OrderedQMapArenaIndex(OrderedQMapArenaIndex && o) : m_arena(o.m_arena), m_buckets(o.m_buckets), m_mask(o.m_mask), m_size(o.m_size)
+        {
+          m_arena->ref();
+          o.m_buckets = nullptr;
+          o.m_mask = 0;
+          o.m_size = 0;
+        }
+
+        OrderedQMapArenaIndex &operator=(const OrderedQMapArenaIndex & o)
+        {
+          if (this != &o)
+          {
+            clear();
+            copyFrom(o);
+          }
+          return *this;
+        }
+
+        OrderedQMapArenaIndex &operator=(OrderedQMapArenaIndex && o)
+        {
+          swap(o);
+          return *this;
+        }
+
+        void swap(OrderedQMapArenaIndex & o)
+        {
+          std::swap(m_arena, o.m_arena);
+          std::swap(m_buckets, o.m_buckets);
+          std::swap(m_mask, o.m_mask);
+          std::swap(m_size, o.m_size);
+        }
+
+        ~OrderedQMapArenaIndex()
+        {
+          clear();
+          m_arena->deref();
+        }
+
+        //only while empty
+        void setArena(OrderedQMapArena * arena)
+        {
+          arena->ref();
+          clear();
+          m_arena->deref();
+          m_arena = arena;
+        }
+
+        int size() const { return m_size; }
+
+        bool isEmpty() const { return m_size == 0; }
+
+        bool contains(const Key & key) const { return find(key, qHash(key)) >= 0; }
+
+        int value(const Key & key, int defaultValue = 0) const
+        {
+          int b = find(key, qHash(key));
+          return b < 0 ? defaultValue : m_buckets[b].slot;
+        }
+
+        void insert(const Key & key, int slot) { operator[](key) = slot; }
+
+        int &operator[](const Key & key)
+        {
+          const uint h = qHash(key);
+          int b = find(key, h);
+          if (b >= 0)
+            return m_buckets[b].slot;
+          if (!m_buckets || 4 * (m_size + 1) > 3 * (m_mask + 1))
+            rehash(m_buckets ? 2 * (m_mask + 1) : 16);
+          b = int(h & m_mask);
+          while (m_buckets[b].slot >= 0)
+            b = (b + 1) & m_mask;
+          new (m_buckets[b].key()) Key(key);
+          m_buckets[b].hash = h;
+          m_buckets[b].slot = 0;
+          ++m_size;
+          return m_buckets[b].slot;
+        }
+
+        int remove(const Key & key)
+        {
+          int i = find(key, qHash(key));
+          if (i < 0)
+            return 0;
+          //move later entries of the probe sequence back into the gap
+          for (int j = (i + 1) & m_mask; m_buckets[j].slot >= 0; j = (j + 1) & m_mask)
+          {
+            int home = int(m_buckets[j].hash & m_mask);
+            bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+            if (stays)
+              continue;
+            *m_buckets[i].key() = std::move(*m_buckets[j].key());
+            m_buckets[i].hash = m_buckets[j].hash;
+            m_buckets[i].slot = m_buckets[j].slot;
+            i = j;
+          }
+          m_buckets[i].key()->~Key();
+          m_buckets[i].slot = -1;
+          --m_size;
+          return 1;
+        }
+
+        void reserve(int n)
+        {
+          int capacity = 16;
+          while (3 * capacity < 4 * n)
+            capacity *= 2;
+          if (!m_buckets || capacity > m_mask + 1)
+            rehash(capacity);
+        }
+
+        //drops the table and hands its memory back to the arena; O(1) when Key is trivially destructible
+        void clear()
+        {
+          if (!std::is_trivially_destructible<Key>::value)
+            for (int b = 0; m_buckets && b <= m_mask; ++b)
+              if (m_buckets[b].slot >= 0)
+                m_buckets[b].key()->~Key();
+          if (m_buckets)
+            m_arena->deallocate(m_buckets, sizeof(Bucket) * size_t(m_mask + 1));
+          m_buckets = nullptr;
+          m_mask = 0;
+          m_size = 0;
+        }
+
+    private:
+        struct Bucket
+        {
+          typename std::aligned_storage<sizeof(Key), alignof(Key)>::type storage;
+          uint hash;
+          int slot; //-1 when the bucket is empty
+
+          Key *key() { return reinterpret_cast<Key *>(&storage); }
+          const Key *key() const { return reinterpret_cast<const Key *>(&storage); }
+        };
+
+        OrderedQMapArena * m_arena;
+        Bucket * m_buckets;
+        int m_mask;
+        int m_size;
+
+        int find(const Key & key, uint h) const
+        {
+          if (!m_buckets)
+            return -1;
+          for (int b = int(h & m_mask); m_buckets[b].slot >= 0; b = (b + 1) & m_mask)
+            if (m_buckets[b].hash == h && *m_buckets[b].key() == key)
+              return b;
+          return -1;
+        }
+
+        void rehash(int capacity)
+        {
+          Bucket * old = m_buckets;
+          const int oldCapacity = old ? m_mask + 1 : 0;
+          m_buckets = static_cast<Bucket *>(m_arena->allocate(sizeof(Bucket) * size_t(capacity), alignof(Bucket)));
+          m_mask = capacity - 1;
+          for (int b = 0; b < capacity; ++b)
+            m_buckets[b].slot = -1;
+          for (int o = 0; o < oldCapacity; ++o)
+          {
+            if (old[o].slot < 0)
+              continue;
+            int b = int(old[o].hash & m_mask);
+            while (m_buckets[b].slot >= 0)
+              b = (b + 1) & m_mask;
+            new (m_buckets[b].key()) Key(std::move(*old[o].key()));
+            old[o].key()->~Key();
+            m_buckets[b].hash = old[o].hash;
+            m_buckets[b].slot = old[o].slot;
+          }
+          m_arena->deallocate(old, sizeof(Bucket) * size_t(oldCapacity));
+        }
+
+        void copyFrom(const OrderedQMapArenaIndex & o)
+        {
+          if (!o.m_buckets)
+            return;
+          m_buckets = static_cast<Bucket *>(m_arena->allocate(sizeof(Bucket) * size_t(o.m_mask + 1), alignof(Bucket)));
+          m_mask = o.m_mask;
+          m_size = o.m_size;
+          for (int b = 0; b <= m_mask; ++b)
+          {
+            m_buckets[b].slot = o.m_buckets[b].slot;
+            m_buckets[b].hash = o.m_buckets[b].hash;
+            if (m_buckets[b].slot >= 0)
+              new (m_buckets[b].key()) Key(*o.m_buckets[b].key());
+          }
+        }
+    };
+
+    //storage policies of CompactOrderedQMap.
+    //QtAllocation keeps the entries in a QVector and the index in a QHash (implicitly shared, cheap to copy).
+    //ArenaAllocation takes both from an OrderedQMapArena, by default the pooled threadArena() of the creating
+    //thread: no allocation per entry, clear() of trivially destructible keys and values is O(1), and the
+    //buffers a map drops are reused by the maps of that thread. With the arena passed to the constructor,
+    //e.g. a Monotonic one, nothing is freed before the arena's reset() or destruction.
+    //A map on threadArena() keeps that arena alive, so it may outlive its thread and be copied, changed or
+    //destroyed on another one; a map on an arena passed to the constructor needs that arena to outlive it
+    //and must not be used by two threads at once. Copies are deep and allocate from the threadArena() of
+    //the copying thread; moving, swapping or returning a map takes its buffers over without a copy.
+    struct QtAllocation
+    {
+        template <class Entry> struct Entries { typedef QVector<Entry> Type; };
+        template <class Key> struct Index { typedef QHash<Key, int> Type; };
+
+        template <class E, class I> static void attach(E &, I &, OrderedQMapArena *) {}
+    };
+
+    struct ArenaAllocation
+    {
+        template <class Entry> struct Entries { typedef OrderedQMapArenaVector<Entry> Type; };
+        template <class Key> struct Index { typedef OrderedQMapArenaIndex<Key> Type; };
+
+        template <class E, class I> static void attach(E & entries, I & index, OrderedQMapArena * arena)
+        {
+          entries.setArena(arena);
+          index.setArena(arena);
+        }
+    };
+
+    //key -> slot index of up to N keys kept inline and searched linearly, spilling into a QHash when
+    //an N+1th key is added; the stored hashes are compared in one fixed length loop the compiler can
+    //vectorize, keys only where the hash matches. Stays spilled until clear().
+    template <class Key, int N> class OrderedQMapSmallIndex
+    {
+        static_assert(N > 0 && N <= 32, "OrderedQMapSmallIndex keeps 1 to 32 keys inline");
+
+    public:
+        OrderedQMapSmallIndex() : m_hashes(), m_count(0), m_spilled(false) {}
+
+        int size() const { return m_spilled ? m_hash.size() : m_count; }
+
+        bool isEmpty() const { return size() == 0; }
+
+        bool contains(const Key & key) const { return m_spilled ? m_hash.contains(key) : find(key) >= 0; }
+
+        int value(const Key & key, int defaultValue = 0) const
+        {
+          if (m_spilled)
+            return m_hash.value(key, defaultValue);
+          int i = find(key);
+          return i < 0 ? defaultValue : m_slots[i];
+        }
+
+        void insert(const Key & key, int slot) { operator[](key) = slot; }
+
+        int &operator[](const Key & key)
+        {
+          if (m_spilled)
+            return m_hash[key];
+          int i = find(key);
+          if (i >= 0)
+            return m_slots[i];
+          if (m_count == N)
+          {
+            spill();
+            return m_hash[key];
+          }
+          m_keys[m_count] = key;
+          m_hashes[m_count] = qHash(key);
+          m_slots[m_count] = 0;
+          return m_slots[m_count++];
+        }
+
+        int remove(const Key & key)
+        {
+          if (m_spilled)
+            return m_hash.remove(key);
+          int i = find(key);
+          if (i < 0)
+            return 0;
+          const int last = --m_count;
+          if (i != last)
+          {
+            m_keys[i] = std::move(m_keys[last]);
+            m_hashes[i] = m_hashes[last];
+            m_slots[i] = m_slots[last];
+          }
+          m_keys[last] = Key();
+          return 1;
+        }
+
+        void reserve(int n)
+        {
+          if (n <= N)
+            return;
+          spill();
+          m_hash.reserve(n);
+        }
+
+        void clear()
+        {
+          for (int i = 0; i < m_count; ++i)
+            m_keys[i] = Key();
+          m_count = 0;
+          m_hash.clear();
+          m_spilled = false;
+        }
+
+    private:
+        Key m_keys[N];
+        uint m_hashes[N];
+        int m_slots[N];
+        int m_count;
+        bool m_spilled;
+        QHash<Key, int> m_hash;
+
+        int find(const Key & key) const
+        {
+          for (quint32 match = matchHashes(qHash(key)), i = 0; match; ++i, match >>= 1)
+            if ((match & 1) && m_keys[i] == key)
+              return int(i);
+          return -1;
+        }
+
+        //bit i is set when the hash of the i-th key is h
+        quint32 matchHashes(uint h) const
+        {
+          quint32 match = 0;
+          int i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+          const __m128i needle = _mm_set1_epi32(int(h));
+          for (; i + 4 <= m_count; i += 4)
+          {
+            const __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(m_hashes + i)), needle);
+            match |= quint32(_mm_movemask_ps(_mm_castsi128_ps(eq))) << i;
+          }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+          const uint32x4_t needle = vdupq_n_u32(h);
+          const uint32x4_t bits = { 1, 2, 4, 8 };
+          for (; i + 4 <= m_count; i += 4)
+            match |= quint32(vaddvq_u32(vandq_u32(vceqq_u32(vld1q_u32(m_hashes + i), needle), bits))) << i;
+#endif
+          for (; i < m_count; ++i)
+            match |= quint32(m_hashes[i] == h) << i;
+          return match;
+        }
+
+        void spill()
+        {
+          if (m_spilled)
+            return;
+          m_hash.reserve(N + 1);
+          for (int i = 0; i < m_count; ++i)
+          {
+            m_hash.insert(m_keys[i], m_slots[i]);
+            m_keys[i] = Key();
+          }
+          m_count = 0;
+          m_spilled = true;
+        }
+    };
+
+    //SmallAllocation<N> stores up to N entries and their index inline, so a small map allocates nothing
+    //for its own storage; a bigger one moves the entries to the heap and the index into a QHash.
+    //Copies are deep.
+    template <int N = 8> struct SmallAllocation
+    {
+        template <class Entry> struct Entries { typedef QVarLengthArray<Entry, N> Type; };
+        template <class Key> struct Index { typedef OrderedQMapSmallIndex<Key, N> Type; };
+
+        template <class E, class I> static void attach(E &, I &, OrderedQMapArena *) {}
+    };
+
+    //ordered map with a single storage: (key, value) entries are kept contiguously in insertion order
+    //and a QHash maps every key to its slot, so indexed access (at, value(int), key) is a plain array access
+    //and every key is stored once in the entries plus once in the hash index.
+    //Keys must be UNIQUE (like OrderedQMap) and need qHash() and operator==; no sort order is kept.
+    //
+    //ImmediateRemoval moves the entries on the shorter side of a removed one, so removing the i-th entry
+    //is O(min(i, n - i)) and the first one O(1): its slot stays free in front of the first entry.
+    //With LazyRemoval, remove() only marks the slot as a tombstone and the storage is compacted
+    //once the dead slots exceed compactionThreshold() of all slots. Removing the first or last entry
+    //never leaves an interior tombstone, so FIFO use keeps indexed access O(1); after removals in the
+    //middle, at()/key()/keyOrder() count live slots until the next compact().
+    //setMaxSize() bounds the map, which then evicts its oldest entries and can serve as a FIFO or LRU cache.
+    //Allocation selects where entries and index live, see QtAllocation, ArenaAllocation and SmallAllocation.
+    template <class Key, class T, class KeyPolicy = CaseSensitiveKeys, class Allocation = QtAllocation> class CompactOrderedQMap
+    {
+    public:
+        enum RemovalMode { ImmediateRemoval, LazyRemoval };
+
+        CompactOrderedQMap() {}
+
+        //takes entries and index from arena with ArenaAllocation, ignored with QtAllocation
+        explicit CompactOrderedQMap(OrderedQMapArena * arena) { Allocation::attach(m_entries, m_slots, arena); }
+
+        //inserts the pairs in list order, like chained operator<< calls
+        CompactOrderedQMap(std::initializer_list<QPair<Key,T> > list) { insertRange(list.begin(), list.end()); }
+
+        CompactOrderedQMap(const CompactOrderedQMap &) = default;
+
+        CompactOrderedQMap &operator=(const CompactOrderedQMap &) = default;
+
+        //takes the storage of other over, with ArenaAllocation without copying an entry; other is left empty
+        CompactOrderedQMap(CompactOrderedQMap && other) : CompactOrderedQMap() { swap(other); }
+
+        CompactOrderedQMap &operator=(CompactOrderedQMap && other)
+        {
+          swap(other);
+          return *this;
+        }
+
+        void swap(CompactOrderedQMap & other)
+        {
+          std::swap(m_entries, other.m_entries);
+          std::swap(m_slots, other.m_slots);
+          std::swap(m_head, other.m_head);
+          std::swap(m_holes, other.m_holes);
+          std::swap(m_removalMode, other.m_removalMode);
+          std::swap(m_compactionThreshold, other.m_compactionThreshold);
+          std::swap(m_stats, other.m_stats);
+          std::swap(m_maxSize, other.m_maxSize);
+          std::swap(m_touchOnAccess, other.m_touchOnAccess);
+          std::swap(m_evicted, other.m_evicted);
+          std::swap(m_foldedKeys, other.m_foldedKeys);
+        }
+
+        //cost of the compactions done so far
+        struct CompactionStats
+        {
+          int compactions;
+          qint64 movedEntries;
+        };
+
+        //iterates in insertion order directly over the entry storage, skipping tombstones;
+        //like QMap::iterator, operator* gives the value and key() the key
+        class ordered_iterator
+        {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef qptrdiff difference_type;
+            typedef T value_type;
+            typedef T *pointer;
+            typedef T &reference;
+
+            ordered_iterator() : c(nullptr), s(0) {}
+
+            const Key &key() const { return c->m_entries.at(s).key; }
+            T &value() const { return c->m_entries[s].value; }
+            T &operator*() const { return value(); }
+            T *operator->() const { return &value(); }
+
+            bool operator==(const ordered_iterator &o) const { return s == o.s; }
+            bool operator!=(const ordered_iterator &o) const { return s != o.s; }
+            ordered_iterator &operator++() { s = c->nextSlot(s); return *this; }
+            ordered_iterator operator++(int) { ordered_iterator r = *this; ++*this; return r; }
+            ordered_iterator &operator--() { s = c->previousSlot(s); return *this; }
+            ordered_iterator operator--(int) { ordered_iterator r = *this; --*this; return r; }
+
+        private:
+            friend class CompactOrderedQMap;
+            ordered_iterator(CompactOrderedQMap *container, int slot) : c(container), s(slot) {}
+
+            CompactOrderedQMap *c;
+            int s;
+        };
+
+        class const_ordered_iterator
+        {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef qptrdiff difference_type;
+            typedef T value_type;
+            typedef const T *pointer;
+            typedef const T &reference;
+
+            const_ordered_iterator() : c(nullptr), s(0) {}
+            const_ordered_iterator(const ordered_iterator &o) : c(o.c), s(o.s) {}
+
+            const Key &key() const { return c->m_entries.at(s).key; }
+            const T &value() const { return c->m_entries.at(s).value; }
+            const T &operator*() const { return value(); }
+            const T *operator->() const { return &value(); }
+
+            bool operator==(const const_ordered_iterator &o) const { return s == o.s; }
+            bool operator!=(const const_ordered_iterator &o) const { return s != o.s; }
+            const_ordered_iterator &operator++() { s = c->nextSlot(s); return *this; }
+            const_ordered_iterator operator++(int) { const_ordered_iterator r = *this; ++*this; return r; }
+            const_ordered_iterator &operator--() { s = c->previousSlot(s); return *this; }
+            const_ordered_iterator operator--(int) { const_ordered_iterator r = *this; --*this; return r; }
+
+        private:
+            friend class CompactOrderedQMap;
+            const_ordered_iterator(const CompactOrderedQMap *container, int slot) : c(container), s(slot) {}
+
+            const CompactOrderedQMap *c;
+            int s;
+        };
+
+        ordered_iterator orderedBegin() { return ordered_iterator(this, m_head); }
+
+        const_ordered_iterator orderedBegin() const { return const_ordered_iterator(this, m_head); }
+
+        ordered_iterator orderedEnd() { return ordered_iterator(this, m_entries.size()); }
+
+        const_ordered_iterator orderedEnd() const { return const_ordered_iterator(this, m_entries.size()); }
+
+        const_ordered_iterator constOrderedBegin() const { return orderedBegin(); }
+
+        const_ordered_iterator constOrderedEnd() const { return orderedEnd(); }
+
+        OrderedQMapRange<ordered_iterator> ordered() { return OrderedQMapRange<ordered_iterator>(orderedBegin(), orderedEnd()); }
+
+        OrderedQMapRange<const_ordered_iterator> ordered() const { return OrderedQMapRange<const_ordered_iterator>(orderedBegin(), orderedEnd()); }
+
+        //allocation free views of the ordered data, e.g. for (const Key & k : map.keysView())
+        typedef OrderedQMapRange<OrderedQMapKeyIterator<Key, const_ordered_iterator> > KeysView;
+        typedef OrderedQMapRange<const_ordered_iterator> ValuesView;
+        typedef OrderedQMapRange<OrderedQMapKeyValueIterator<Key, const T, const_ordered_iterator> > PairsView;
+        typedef OrderedQMapRange<OrderedQMapKeyValueIterator<Key, T, ordered_iterator> > MutablePairsView;
+
+        KeysView keysView() const
+        {
+          typedef OrderedQMapKeyIterator<Key, const_ordered_iterator> It;
+          return KeysView(It(orderedBegin()), It(orderedEnd()));
+        }
+
+        ValuesView valuesView() const { return ordered(); }
+
+        PairsView pairsView() const
+        {
+          typedef OrderedQMapKeyValueIterator<Key, const T, const_ordered_iterator> It;
+          return PairsView(It(orderedBegin()), It(orderedEnd()));
+        }
+
+        MutablePairsView pairsView()
+        {
+          typedef OrderedQMapKeyValueIterator<Key, T, ordered_iterator> It;
+          return MutablePairsView(It(orderedBegin()), It(orderedEnd()));
+        }
+
+        //preallocates entry storage and the key index for n keys in total
+        void reserve(int n)
+        {
+          m_entries.reserve(n);
+          m_slots.reserve(n);
+        }
+
+        //inserts every pair of [first, last) in order, like chained insert() calls
+        template <class InputIterator> void insertRange(InputIterator first, InputIterator last)
+        {
+          reserveRange(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
+          for (; first != last; ++first)
+            insert((*first).first, (*first).second);
+        }
+
+        bool contains(const Key & key) const { return m_slots.contains(key); }
+
+        //O(1) for Qt::CaseInsensitive with the CaseInsensitiveKeys policy
+        bool contains(const QString & key, Qt::CaseSensitivity cs) const
+        {
+          if (cs == Qt::CaseSensitive)
+            return contains(key);
+          return findKey(key) != nullptr;
+        }
+
+        const T operator[](const Key & key) const { return value(key); }
+
+        T & operator[](const Key & key)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+            slot = appendEntry(key, T());
+          return m_entries[slot].value;
+        }
+
+        //inserts or replaces the value of key; returns the order index of the key.
+        //A new key is appended, at size() - 1, in O(1); finding the index of a present key counts the live
+        //slots in front of it, O(n) while LazyRemoval has left tombstones between the entries
+        int insert(const Key & key, const T & value)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+          {
+            appendEntry(key, T(value));
+            return size() - 1;
+          }
+          m_entries[slot].value = value;
+          return orderOf(slot);
+        }
+
+        int insert(const Key & key, T && value)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+          {
+            appendEntry(key, std::move(value));
+            return size() - 1;
+          }
+          m_entries[slot].value = std::move(value);
+          return orderOf(slot);
+        }
+
+        int append(const Key & key, const T & value) { return insert(key, value); }
+
+        int append(const Key & key, T && value) { return insert(key, std::move(value)); }
+
+        //inserts key in front of the others if it is not present yet;
+        //O(1) when a tombstone is free in front of the first entry, otherwise O(n) because all slots move
+        int prepend(const Key & key, const T & value)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot >= 0)
+          {
+            m_entries[slot].value = value;
+            return orderOf(slot);
+          }
+          return prependEntry(key, T(value));
+        }
+
+        int prepend(const Key & key, T && value)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot >= 0)
+          {
+            m_entries[slot].value = std::move(value);
+            return orderOf(slot);
+          }
+          return prependEntry(key, std::move(value));
+        }
+
+        //builds a temporary T from args and moves it into the map like insert(key, T &&), replacing an existing value
+        template <class... Args> int emplace(const Key & key, Args &&... args)
+        { return insert(key, T(std::forward<Args>(args)...)); }
+
+        template <class... Args> int emplaceBack(const Key & key, Args &&... args)
+        { return insert(key, T(std::forward<Args>(args)...)); }
+
+        template <class... Args> int emplaceFront(const Key & key, Args &&... args)
+        { return prepend(key, T(std::forward<Args>(args)...)); }
+
+        //like emplace, but leaves an existing value of key untouched and does not build a T for it;
+        //returns the order index of key (with the cost insert() has), the bool is true when key was inserted
+        template <class... Args> QPair<int, bool> tryEmplace(const Key & key, Args &&... args)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot >= 0)
+            return qMakePair(orderOf(slot), false);
+          appendEntry(key, T(std::forward<Args>(args)...));
+          return qMakePair(size() - 1, true);
+        }
+
+        Key replaceAt(int index, const T & value)
+        {
+          Entry & e = m_entries[slotAt(index)];
+          e.value = value;
+          return e.key;
+        }
+
+        Key replaceAt(int index, T && value)
+        {
+          Entry & e = m_entries[slotAt(index)];
+          e.value = std::move(value);
+          return e.key;
+        }
+
+        //the value at index, which must be valid
+        const T & at(int index) const { return m_entries.at(slotAt(index)).value; }
+
+        T & atRef(int index) { return m_entries[slotAt(index)].value; }
+
+        T value(int index) const
+        {
+          int slot = slotAt(index);
+          return slot < 0 ? T() : m_entries.at(slot).value;
+        }
+
+        //returns the order index key had, or -1; like keyOrder() that is O(n) while LazyRemoval has left
+        //tombstones between the entries
+        int remove(const Key & key)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+            return -1;
+          int i = orderOf(slot);
+          removeEntryAt(slot);
+          return i;
+        }
+
+        Key removeAt(int i)
+        {
+          int slot = slotAt(i);
+          Key key = m_entries.at(slot).key;
+          removeEntryAt(slot);
+          return key;
+        }
+
+        Key removeLast()
+        {
+          Key key = m_entries.last().key;
+          removeEntryAt(m_entries.size() - 1);
+          return key;
+        }
+
+        //the last slot is never a tombstone
+        QPair<Key, T> last() const
+        {
+          if (isEmpty())
+            return QPair<Key, T>();
+          const Entry & e = m_entries.last();
+          return QPair<Key, T>(e.key, e.value);
+        }
+
+        bool isEmpty() const { return m_slots.isEmpty(); }
+
+        const T value(const Key & key) const { return value(key, T()); }
+
+        const T value(const Key & key, const T & defaultValue) const
+        {
+          int slot = m_slots.value(key, -1);
+          return slot < 0 ? defaultValue : m_entries.at(slot).value;
+        }
+
+        //on a non-const map with touchOnAccess() set, the looked up key also becomes the most recently used;
+        //a template so that lookups by a string view keep going to the const overloads
+        template <class K> typename std::enable_if<std::is_same<K, Key>::value, const T>::type value(const K & key)
+        { return value(key, T()); }
+
+        template <class K> typename std::enable_if<std::is_same<K, Key>::value, const T>::type value(const K & key, const T & defaultValue)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+            return defaultValue;
+          if (m_touchOnAccess)
+            slot = touchSlot(slot);
+          return m_entries.at(slot).value;
+        }
+
+        //case (in)sensitive value lookup, O(1) with the CaseInsensitiveKeys policy
+        const T value(const QString & key, Qt::CaseSensitivity cs, const T & defaultValue = T()) const
+        {
+          if (cs == Qt::CaseSensitive)
+            return value(key, defaultValue);
+          const Key * k = findKey(key);
+          return k ? value(*k, defaultValue) : defaultValue;
+        }
+
+        //touches the key like value(const Key &) on a non-const map; also keeps value(key, Qt::CaseInsensitive)
+        //from matching the touching template with the Qt::CaseSensitivity converted to T
+        const T value(const QString & key, Qt::CaseSensitivity cs, const T & defaultValue = T())
+        {
+          const CompactOrderedQMap & self = *this;
+          if (!m_touchOnAccess)
+            return self.value(key, cs, defaultValue);
+          if (cs == Qt::CaseSensitive)
+            return value(key, defaultValue);
+          const Key * k = findKey(key);
+          if (!k)
+            return defaultValue;
+          //touching moves the entry or removes the key from the folded index k points into
+          const Key found = *k;
+          return value(found, defaultValue);
+        }
+
+        //lookups by QStringView, QLatin1String or UTF-8 const char*, e.g. map.value("literal");
+        //with the StringViewKeys policy they go through the folded index and build no QString
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, bool>::type
+        contains(View key, Qt::CaseSensitivity cs = Qt::CaseSensitive) const
+        {
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key, cs) != nullptr;
+          return contains(OrderedQMapStringView<View>::toString(key), cs);
+        }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        value(View key, const T & defaultValue = T()) const
+        { return value(key, Qt::CaseSensitive, defaultValue); }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        value(View key, Qt::CaseSensitivity cs, const T & defaultValue = T()) const
+        {
+          if (!KeyPolicy::CaseFoldedIndex)
+            return value(OrderedQMapStringView<View>::toString(key), cs, defaultValue);
+          const Key * k = m_foldedKeys.find(key, cs);
+          return k ? m_entries.at(m_slots.value(*k)).value : defaultValue;
+        }
+
+        //touches the key like value(const Key &) on a non-const map
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        value(View key, const T & defaultValue = T())
+        {
+          const CompactOrderedQMap & self = *this;
+          if (!m_touchOnAccess)
+            return self.value(key, defaultValue);
+          if (!KeyPolicy::CaseFoldedIndex)
+            return value(OrderedQMapStringView<View>::toString(key), defaultValue);
+          const Key * k = m_foldedKeys.find(key, Qt::CaseSensitive);
+          if (!k)
+            return defaultValue;
+          //touching removes the key from the folded index k points into
+          const Key found = *k;
+          return value(found, defaultValue);
+        }
+
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, const T>::type
+        operator[](View key) const { return value(key); }
+
+        //only builds a QString key when key is not in the map yet
+        template <class View> typename std::enable_if<OrderedQMapStringView<View>::Enabled, T &>::type
+        operator[](View key)
+        {
+          const Key * k = KeyPolicy::CaseFoldedIndex ? m_foldedKeys.find(key, Qt::CaseSensitive) : nullptr;
+          if (k)
+            return m_entries[m_slots.value(*k)].value;
+          return operator[](OrderedQMapStringView<View>::toString(key));
+        }
+
+        Key key(int index) const
+        {
+          int slot = slotAt(index);
+          return slot < 0 ? Key() : m_entries.at(slot).key;
+        }
+
+        int size() const { return m_slots.size(); }
+
+        int count(const Key & key) const { return m_slots.contains(key) ? 1 : 0; }
+
+        int length() const { return m_slots.size(); }
+
+        QList<Key> keys() const
+        {
+          QList<Key> res;
+          res.reserve(size());
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive)
+              res.append(m_entries.at(s).key);
+          return res;
+        }
+
+        int keyOrder(const Key & key) const
+        {
+          int slot = m_slots.value(key, -1);
+          return slot < 0 ? -1 : orderOf(slot);
+        }
+
+        void clear()
+        {
+          m_entries.clear();
+          m_slots.clear();
+          m_foldedKeys.clear();
+          m_head = 0;
+          m_holes = 0;
+        }
+
+        //moves the entry at position from to position to, shifting the entries in between; O(|to - from|),
+        //after a compact() when LazyRemoval has left tombstones between the entries
+        void move(int from, int to)
+        {
+          if (from == to)
+            return;
+          if (m_holes > 0)
+            compact();
+          const int a = m_head + from;
+          const int b = m_head + to;
+          Entry * entries = &m_entries[0];
+          if (a < b)
+            std::rotate(entries + a, entries + a + 1, entries + b + 1);
+          else
+            std::rotate(entries + b, entries + a, entries + a + 1);
+          reindex(qMin(a, b), qMax(a, b));
+        }
+
+        //exchanges the positions of the entries at i and j
+        void swapAt(int i, int j)
+        {
+          if (i == j)
+            return;
+          const int a = slotAt(i);
+          const int b = slotAt(j);
+          std::swap(m_entries[a], m_entries[b]);
+          m_slots[m_entries.at(a).key] = a;
+          m_slots[m_entries.at(b).key] = b;
+        }
+
+        //returns false when key is not present
+        bool moveToFront(const Key & key)
+        {
+          int i = keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, 0);
+          return true;
+        }
+
+        bool moveToBack(const Key & key)
+        {
+          int i = keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, size() - 1);
+          return true;
+        }
+
+        //stable sort of the insertion order by value, lessThan(const T &, const T &); the entries are
+        //sorted in place, after a compact()
+        template <class LessThan> void sortOrder(LessThan lessThan)
+        { sortEntries([&](const Entry & a, const Entry & b) { return lessThan(a.value, b.value); }); }
+
+        //stable sort of the insertion order by key, lessThan(const Key &, const Key &)
+        template <class LessThan> void sortOrderByKey(LessThan lessThan)
+        { sortEntries([&](const Entry & a, const Entry & b) { return lessThan(a.key, b.key); }); }
+
+        //removes key and returns its value moved out of the map, or T() when key is not present
+        T take(const Key & key)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+            return T();
+          T value = std::move(m_entries[slot].value);
+          removeEntryAt(slot);
+          return value;
+        }
+
+        //returns the iterator to the entry that followed it in insertion order
+        ordered_iterator erase(ordered_iterator it)
+        {
+          const int i = orderOf(it.s);
+          removeEntryAt(it.s);
+          const int slot = slotAt(i);
+          return ordered_iterator(this, slot < 0 ? m_entries.size() : slot);
+        }
+
+        enum MergePolicy
+        {
+          OverwriteExisting, //values of other replace those of present keys, which keep their position
+          KeepExisting,      //present keys keep their value, only the new keys of other are added
+          MoveToBack         //like OverwriteExisting, but all keys of other end up at the back in other's order
+        };
+
+        //adds the entries of other in its insertion order, in one pass over other with the storage presized;
+        //new keys are appended. MoveToBack first drops the present keys of other in a single compact()
+        CompactOrderedQMap & merge(const CompactOrderedQMap & other, MergePolicy policy = OverwriteExisting)
+        {
+          if (&other == this || other.isEmpty())
+            return *this;
+          reserve(m_entries.size() + other.size());
+          if (policy == MoveToBack)
+          {
+            for (const_ordered_iterator it = other.orderedBegin(); it != other.orderedEnd(); ++it)
+            {
+              int slot = m_slots.value(it.key(), -1);
+              if (slot < 0)
+                continue;
+              m_slots.remove(it.key());
+              m_foldedKeys.remove(it.key());
+              m_entries[slot] = Entry { Key(), T(), false };
+              ++m_holes;
+            }
+            compact();
+          }
+          for (const_ordered_iterator it = other.orderedBegin(); it != other.orderedEnd(); ++it)
+          {
+            int slot = m_slots.value(it.key(), -1);
+            if (slot < 0)
+              appendEntry(it.key(), T(it.value()));
+            else if (policy != KeepExisting)
+              m_entries[slot].value = it.value();
+          }
+          return *this;
+        }
+
+        //keys stay unique: a key present in both maps gets the value of other
+        CompactOrderedQMap & unite(const CompactOrderedQMap & other) { return merge(other, OverwriteExisting); }
+
+        RemovalMode removalMode() const { return m_removalMode; }
+
+        //switching back to ImmediateRemoval compacts the storage. A bounded map (maxSize() > 0) rejects
+        //ImmediateRemoval and returns false, it would make every eviction and touch() O(n);
+        //call setMaxSize(0) first
+        bool setRemovalMode(RemovalMode mode)
+        {
+          if (mode == ImmediateRemoval && m_maxSize > 0)
+            return false;
+          m_removalMode = mode;
+          if (mode == ImmediateRemoval)
+            compact();
+          return true;
+        }
+
+        qreal compactionThreshold() const { return m_compactionThreshold; }
+
+        //fraction (0..1] of dead slots that triggers a compaction; with ImmediateRemoval only the slots
+        //freed in front of the first entry are dead
+        void setCompactionThreshold(qreal threshold) { m_compactionThreshold = threshold; }
+
+        //removes all tombstones; O(n)
+        void compact()
+        {
+          if (m_head == 0 && m_holes == 0)
+            return;
+          int to = 0;
+          for (int s = m_head; s < m_entries.size(); ++s)
+          {
+            if (!m_entries.at(s).alive)
+              continue;
+            if (s != to)
+            {
+              m_entries[to] = std::move(m_entries[s]);
+              m_slots[m_entries.at(to).key] = to;
+              ++m_stats.movedEntries;
+            }
+            ++to;
+          }
+          m_entries.resize(to);
+          m_head = 0;
+          m_holes = 0;
+          ++m_stats.compactions;
+        }
+
+        //number of slots, including tombstones
+        int slotCount() const { return m_entries.size(); }
+
+        CompactionStats compactionStats() const { return m_stats; }
+
+        int maxSize() const { return m_maxSize; }
+
+        //bounded mode for maxSize > 0: inserting a new key into a full map first evicts the first entry
+        //in insertion order, so the map works as a FIFO cache, or as an LRU cache with touchOnAccess().
+        //Switches to LazyRemoval, which makes eviction and touch() amortized O(1), and keeps it until the
+        //bound is removed with 0. Inserting a new key returns its order size() - 1 without counting slots
+        void setMaxSize(int maxSize)
+        {
+          m_maxSize = qMax(0, maxSize);
+          if (m_maxSize == 0)
+            return;
+          m_removalMode = LazyRemoval;
+          while (size() > m_maxSize)
+            evictFirst();
+        }
+
+        bool touchOnAccess() const { return m_touchOnAccess; }
+
+        //value(key) on a non-const map moves key to the back like touch()
+        void setTouchOnAccess(bool touch) { m_touchOnAccess = touch; }
+
+        //f(const Key &, const T &) is called for every evicted entry right before it is removed;
+        //it must not modify the map
+        template <class Function> void setEvictionCallback(Function f) { m_evicted = f; }
+
+        //moves key to the back of the insertion order, making it the most recently used one;
+        //returns false when key is not present
+        bool touch(const Key & key)
+        {
+          int slot = m_slots.value(key, -1);
+          if (slot < 0)
+            return false;
+          touchSlot(slot);
+          return true;
+        }
+
+        QMap<Key, T> toQMap() const
+        {
+          QMap<Key, T> res;
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive)
+              res.insert(m_entries.at(s).key, m_entries.at(s).value);
+          return res;
+        }
+
+        QList<T> values() const
+        {
+          QList<T> res;
+          res.reserve(size());
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive)
+              res.append(m_entries.at(s).value);
+          return res;
+        }
+
+        QList<QPair<T, Key> > valueKeyList(bool addEmptyPair = false, bool putEmptyPairAsFirst = true) const
+        {
+          QList<QPair<T, Key> > res;
+          res.reserve(size() + 1);
+          if (addEmptyPair && putEmptyPairAsFirst)
+            res.append(qMakePair(T(), Key()));
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive)
+              res.append(qMakePair(m_entries.at(s).value, m_entries.at(s).key));
+          if (addEmptyPair && !putEmptyPairAsFirst)
+            res.append(qMakePair(T(), Key()));
+          return res;
+        }
+
+        CompactOrderedQMap& operator()(const Key & key, const T & value)
+        {
+          insert(key, value);
+          return *this;
+        }
+
+        CompactOrderedQMap& operator()(const Key & key, T && value)
+        {
+          insert(key, std::move(value));
+          return *this;
+        }
+
+        CompactOrderedQMap &operator<< (const QPair<Key,T> &t)
+        {
+          this->insert(t.first, t.second);
+          return *this;
+        }
+
+        CompactOrderedQMap &operator<< (QPair<Key,T> &&t)
+        {
+          this->insert(t.first, std::move(t.second));
+          return *this;
+        }
+
+        CompactOrderedQMap &operator>> (const QPair<Key,T> &t)
+        {
+          this->prepend(t.first, t.second);
+          return *this;
+        }
+
+        //uses the same stream format as OrderedQMap, so both containers can read each other's data
+        friend QDataStream &operator <<(QDataStream &out, const CompactOrderedQMap &obj)
+        {
+          OrderedQMapStream::writeHeader(out, obj.size());
+          for (const_ordered_iterator it = obj.orderedBegin(); it != obj.orderedEnd(); ++it)
+            out << it.key() << it.value();
+          return out;
+        }
+
+        friend QDataStream &operator >>(QDataStream &in, CompactOrderedQMap &obj)
+        {
+          qint32 count = 0;
+          bool legacy = false;
+          if (!OrderedQMapStream::readHeader(in, count, legacy))
+            return in;
+          if (legacy)
+          {
+            OrderedQMapStream::readLegacy<Key, T>(in, count, obj);
+            return in;
+          }
+          obj.m_entries.reserve(obj.m_entries.size() + OrderedQMapStream::reservation(count));
+          obj.m_slots.reserve(obj.m_slots.size() + OrderedQMapStream::reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Key k;
+            T v;
+            in >> k >> v;
+            if (in.status() != QDataStream::Ok)
+              break;
+            obj.insert(k, std::move(v));
+          }
+          return in;
+        }
+
+    private:
+        struct Entry
+        {
+          Key key;
+          T value;
+          bool alive;
+        };
+
+        typename Allocation::template Entries<Entry>::Type m_entries;
+        typename Allocation::template Index<Key>::Type m_slots;
+        int m_head = 0;   //tombstones in front of the first live slot
+        int m_holes = 0;  //tombstones between live slots
+        RemovalMode m_removalMode = ImmediateRemoval;
+        qreal m_compactionThreshold = 0.5;
+        CompactionStats m_stats = { 0, 0 };
+        int m_maxSize = 0;
+        bool m_touchOnAccess = false;
+        std::function<void(const Key &, const T &)> m_evicted;
+        OrderedQMapFoldedIndex<Key, KeyPolicy::CaseFoldedIndex> m_foldedKeys;
+
+        int appendEntry(const Key & key, T && value)
+        {
+          makeRoom();
+          int slot = m_entries.size();
+          Entry e = { key, std::move(value), true };
+          m_entries.append(std::move(e));
+          m_slots.insert(key, slot);
+          m_foldedKeys.insert(key);
+          return slot;
+        }
+
+        template <class InputIterator> void reserveRange(InputIterator, InputIterator, std::input_iterator_tag) {}
+
+        template <class ForwardIterator> void reserveRange(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+        { reserve(m_entries.size() + int(std::distance(first, last))); }
+
+        int prependEntry(const Key & key, T && value)
+        {
+          makeRoom();
+          Entry e = { key, std::move(value), true };
+          m_foldedKeys.insert(key);
+          if (m_head > 0)
+          {
+            m_entries[--m_head] = std::move(e);
+            m_slots.insert(key, m_head);
+            return 0;
+          }
+          m_entries.prepend(std::move(e));
+          reindexFrom(0);
+          return 0;
+        }
+
+        //in bounded mode, evicts entries until one more fits; called before a new key is stored
+        void makeRoom()
+        {
+          if (m_maxSize == 0)
+            return;
+          while (size() >= m_maxSize)
+            evictFirst();
+        }
+
+        //the first live slot is m_head, so this is O(1) with LazyRemoval
+        void evictFirst()
+        {
+          const Entry & e = m_entries.at(m_head);
+          if (m_evicted)
+            m_evicted(e.key, e.value);
+          removeEntryAt(m_head);
+        }
+
+        //moves the entry in slot to the back, leaving a tombstone with LazyRemoval; returns its new slot
+        int touchSlot(int slot)
+        {
+          if (slot == m_entries.size() - 1)
+            return slot;
+          Key key = m_entries.at(slot).key;
+          T value = std::move(m_entries[slot].value);
+          removeEntryAt(slot);
+          return appendEntry(key, std::move(value));
+        }
+
+        //the stored key equal to key ignoring case, or nullptr
+        const Key * findKey(const QString & key) const
+        {
+          if (KeyPolicy::CaseFoldedIndex)
+            return m_foldedKeys.find(key);
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive && key.compare(m_entries.at(s).key, Qt::CaseInsensitive) == 0)
+              return &m_entries.at(s).key;
+          return nullptr;
+        }
+
+        //slot of the index-th live entry or -1
+        int slotAt(int index) const
+        {
+          if (index < 0 || index >= size())
+            return -1;
+          if (m_holes == 0)
+            return m_head + index;
+          for (int s = m_head; s < m_entries.size(); ++s)
+            if (m_entries.at(s).alive && index-- == 0)
+              return s;
+          return -1;
+        }
+
+        int nextSlot(int slot) const
+        {
+          ++slot;
+          while (slot < m_entries.size() && !m_entries.at(slot).alive)
+            ++slot;
+          return slot;
+        }
+
+        int previousSlot(int slot) const
+        {
+          --slot;
+          while (slot > m_head && !m_entries.at(slot).alive)
+            --slot;
+          return slot;
+        }
+
+        //order index of a live slot
+        int orderOf(int slot) const
+        {
+          if (m_holes == 0)
+            return slot - m_head;
+          int index = 0;
+          for (int s = m_head; s < slot; ++s)
+            if (m_entries.at(s).alive)
+              ++index;
+          return index;
+        }
+
+        void removeEntryAt(int slot)
+        {
+          m_slots.remove(m_entries.at(slot).key);
+          m_foldedKeys.remove(m_entries.at(slot).key);
+          if (m_removalMode == ImmediateRemoval)
+          {
+            removeEntryImmediately(slot);
+            return;
+          }
+          //release the payload of the tombstone right away
+          m_entries[slot] = Entry { Key(), T(), false };
+          if (slot == m_entries.size() - 1)
+          {
+            m_entries.removeLast();
+            while (!m_entries.isEmpty() && !m_entries.last().alive)
+            {
+              m_entries.removeLast();
+              if (m_entries.size() >= m_head)
+                --m_holes;
+            }
+            m_head = qMin(m_head, m_entries.size());
+          }
+          else if (slot == m_head)
+          {
+            ++m_head;
+            while (m_head < m_entries.size() && !m_entries.at(m_head).alive)
+            {
+              ++m_head;
+              --m_holes;
+            }
+          }
+          else
+          {
+            ++m_holes;
+          }
+          if (m_head + m_holes > m_compactionThreshold * m_entries.size())
+            compact();
+        }
+
+        //closes the gap from whichever side of slot is shorter: the entries in front of it move back by
+        //one and leave a dead slot in front of the first entry, which prepend() reuses and a compact() drops
+        void removeEntryImmediately(int slot)
+        {
+          if (slot - m_head >= m_entries.size() - 1 - slot)
+          {
+            m_entries.remove(slot);
+            reindexFrom(slot);
+          }
+          else
+          {
+            for (int s = slot; s > m_head; --s)
+            {
+              m_entries[s] = std::move(m_entries[s - 1]);
+              m_slots[m_entries.at(s).key] = s;
+            }
+            m_entries[m_head] = Entry { Key(), T(), false };
+            ++m_head;
+          }
+          if (m_head > m_compactionThreshold * m_entries.size())
+            compact();
+        }
+
+        void reindexFrom(int slot)
+        {
+          for (int i = slot; i < m_entries.size(); ++i)
+            if (m_entries.at(i).alive)
+              m_slots[m_entries.at(i).key] = i;
+        }
+
+        //reindexes the live slots first to last after their entries were rearranged
+        void reindex(int first, int last)
+        {
+          for (int s = first; s <= last; ++s)
+            if (m_entries.at(s).alive)
+              m_slots[m_entries.at(s).key] = s;
+        }
+
+        template <class EntryLessThan> void sortEntries(EntryLessThan lessThan)
+        {
+          if (size() < 2)
+            return;
+          compact();
+          Entry * entries = &m_entries[0];
+          std::stable_sort(entries, entries + m_entries.size(), lessThan);
+          reindex(0, m_entries.size() - 1);
+        }
 
     };
 
@@ -437,4 +3715,564 @@ namespace ActionNet
 typedef ActionNet::OrderedQMap<QString, QVariant> QVariantOrderedQMap;
 Q_DECLARE_METATYPE(QVariantOrderedQMap)
 
+//for the many maps of a few entries: no allocation up to 8 entries
+typedef ActionNet::CompactOrderedQMap<QString, QVariant, ActionNet::CaseSensitiveKeys, ActionNet::SmallAllocation<8> > QVariantSmallOrderedQMap;
+
+namespace ActionNet
+{
+
+    //JSON support for QVariantOrderedQMap that keeps the insertion order of object members
+    //(QJsonObject sorts them). Text is written and parsed directly as UTF-8, without a QJsonDocument.
+    //Nested objects are read as QVariantOrderedQMap, arrays as QVariantList, integral numbers as int
+    //or qlonglong, other numbers as double and null as an invalid QVariant.
+    //
+    //\code
+    //  QVariantOrderedQMap map = ActionNet::OrderedQMapJson::fromJson("{\"b\": 1, \"a\": [true, null]}");
+    //  QByteArray json = ActionNet::OrderedQMapJson::toJson(map); // {"b":1,"a":[true,null]}
+    //\endcode
+    class OrderedQMapJson
+    {
+    public:
+        static QByteArray toJson(const QVariantOrderedQMap & map, QJsonDocument::JsonFormat format = QJsonDocument::Compact)
+        {
+          QByteArray res;
+          writeObject(res, map, format == QJsonDocument::Indented ? 0 : -1);
+          if (format == QJsonDocument::Indented)
+            res.append('\n');
+          return res;
+        }
+
+        //returns an empty map and fills error if json is not a valid JSON object
+        static QVariantOrderedQMap fromJson(const QByteArray & json, QJsonParseError * error = nullptr)
+        {
+          Reader reader(json.constData(), json.constData() + json.size());
+          QVariantOrderedQMap res;
+          reader.skipSpace();
+          if (reader.p == reader.end || *reader.p != '{')
+            reader.fail(QJsonParseError::MissingObject);
+          else if (reader.readObject(res, 0))
+          {
+            reader.skipSpace();
+            if (reader.p != reader.end)
+              reader.fail(QJsonParseError::GarbageAtEnd);
+          }
+          if (reader.error != QJsonParseError::NoError)
+            res.clear();
+          if (error)
+          {
+            error->error = reader.error;
+            error->offset = reader.error == QJsonParseError::NoError ? 0 : int(reader.p - json.constData());
+          }
+          return res;
+        }
+
+    private:
+        //indent < 0 writes the compact format
+        static void newLine(QByteArray & out, int indent)
+        {
+          if (indent < 0)
+            return;
+          out.append('\n');
+          for (int i = 0; i < indent; ++i)
+            out.append("    ", 4);
+        }
+
+        static void writeObject(QByteArray & out, const QVariantOrderedQMap & map, int indent)
+        {
+          out.append('{');
+          const int inner = indent < 0 ? -1 : indent + 1;
+          for (QVariantOrderedQMap::const_ordered_iterator it = map.orderedBegin(); it != map.orderedEnd(); ++it)
+          {
+            if (it != map.orderedBegin())
+              out.append(',');
+            newLine(out, inner);
+            writeString(out, it.key());
+            out.append(indent < 0 ? ":" : ": ");
+            writeValue(out, it.value(), inner);
+          }
+          if (!map.isEmpty())
+            newLine(out, indent);
+          out.append('}');
+        }
+
+        template <class Map>
+        static void writeQMap(QByteArray & out, const Map & map, int indent)
+        {
+          out.append('{');
+          const int inner = indent < 0 ? -1 : indent + 1;
+          for (typename Map::const_iterator it = map.constBegin(); it != map.constEnd(); ++it)
+          {
+            if (it != map.constBegin())
+              out.append(',');
+            newLine(out, inner);
+            writeString(out, it.key());
+            out.append(indent < 0 ? ":" : ": ");
+            writeValue(out, it.value(), inner);
+          }
+          if (!map.isEmpty())
+            newLine(out, indent);
+          out.append('}');
+        }
+
+        template <class List>
+        static void writeArray(QByteArray & out, const List & list, int indent)
+        {
+          out.append('[');
+          const int inner = indent < 0 ? -1 : indent + 1;
+          for (int i = 0; i < list.size(); ++i)
+          {
+            if (i > 0)
+              out.append(',');
+            newLine(out, inner);
+            writeValue(out, QVariant(list.at(i)), inner);
+          }
+          if (!list.isEmpty())
+            newLine(out, indent);
+          out.append(']');
+        }
+
+        static void writeValue(QByteArray & out, const QVariant & v, int indent)
+        {
+          if (v.userType() == qMetaTypeId<QVariantOrderedQMap>())
+          {
+            writeObject(out, *static_cast<const QVariantOrderedQMap *>(v.constData()), indent);
+            return;
+          }
+          switch (v.userType())
+          {
+            case QMetaType::UnknownType:
+              out.append("null", 4);
+              break;
+            case QMetaType::Bool:
+              if (v.toBool())
+                out.append("true", 4);
+              else
+                out.append("false", 5);
+              break;
+            case QMetaType::Int:
+            case QMetaType::UInt:
+            case QMetaType::LongLong:
+            case QMetaType::Short:
+            case QMetaType::Long:
+            case QMetaType::Char:
+            case QMetaType::SChar:
+              out.append(QByteArray::number(v.toLongLong()));
+              break;
+            case QMetaType::ULongLong:
+            case QMetaType::UShort:
+            case QMetaType::ULong:
+            case QMetaType::UChar:
+              out.append(QByteArray::number(v.toULongLong()));
+              break;
+            case QMetaType::Float:
+            case QMetaType::Double:
+            {
+              const double d = v.toDouble();
+              if (std::isfinite(d))
+                out.append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+              else
+                out.append("null", 4);
+              break;
+            }
+            case QMetaType::QVariantList:
+              writeArray(out, *static_cast<const QVariantList *>(v.constData()), indent);
+              break;
+            case QMetaType::QStringList:
+              writeArray(out, *static_cast<const QStringList *>(v.constData()), indent);
+              break;
+            case QMetaType::QVariantMap:
+              writeQMap(out, *static_cast<const QVariantMap *>(v.constData()), indent);
+              break;
+            case QMetaType::QVariantHash:
+              writeQMap(out, *static_cast<const QVariantHash *>(v.constData()), indent);
+              break;
+            case QMetaType::QString:
+              writeString(out, *static_cast<const QString *>(v.constData()));
+              break;
+            default:
+              if (v.canConvert<QString>())
+                writeString(out, v.toString());
+              else
+                out.append("null", 4);
+          }
+        }
+
+        static void writeString(QByteArray & out, const QString & str)
+        {
+          static const char hex[] = "0123456789abcdef";
+          out.append('"');
+          const QChar * c = str.constData();
+          const QChar * end = c + str.size();
+          for (; c != end; ++c)
+          {
+            uint u = c->unicode();
+            switch (u)
+            {
+              case '"': out.append("\\\"", 2); continue;
+              case '\\': out.append("\\\\", 2); continue;
+              case '\b': out.append("\\b", 2); continue;
+              case '\f': out.append("\\f", 2); continue;
+              case '\n': out.append("\\n", 2); continue;
+              case '\r': out.append("\\r", 2); continue;
+              case '\t': out.append("\\t", 2); continue;
+              default: break;
+            }
+            if (u < 0x20)
+            {
+              const char esc[] = { '\\', 'u', '0', '0', hex[u >> 4], hex[u & 0xf] };
+              out.append(esc, 6);
+            }
+            else if (u < 0x80)
+              out.append(char(u));
+            else if (u < 0x800)
+            {
+              out.append(char(0xc0 | (u >> 6)));
+              out.append(char(0x80 | (u & 0x3f)));
+            }
+            else if (QChar::isHighSurrogate(u) && c + 1 != end && c[1].isLowSurrogate())
+            {
+              u = QChar::surrogateToUcs4(c[0], c[1]);
+              ++c;
+              out.append(char(0xf0 | (u >> 18)));
+              out.append(char(0x80 | ((u >> 12) & 0x3f)));
+              out.append(char(0x80 | ((u >> 6) & 0x3f)));
+              out.append(char(0x80 | (u & 0x3f)));
+            }
+            else if (QChar::isSurrogate(u))
+            {
+              //a lone surrogate has no UTF-8 form; the escape reads back as the same QChar
+              const char esc[] = { '\\', 'u', hex[u >> 12], hex[(u >> 8) & 0xf], hex[(u >> 4) & 0xf], hex[u & 0xf] };
+              out.append(esc, 6);
+            }
+            else
+            {
+              out.append(char(0xe0 | (u >> 12)));
+              out.append(char(0x80 | ((u >> 6) & 0x3f)));
+              out.append(char(0x80 | (u & 0x3f)));
+            }
+          }
+          out.append('"');
+        }
+
+        struct Reader
+        {
+          enum { MaxDepth = 1024 };
+
+          const char * p;
+          const char * end;
+          QJsonParseError::ParseError error;
+
+          Reader(const char * begin, const char * last) : p(begin), end(last), error(QJsonParseError::NoError) {}
+
+          bool fail(QJsonParseError::ParseError e)
+          {
+            if (error == QJsonParseError::NoError)
+              error = e;
+            return false;
+          }
+
+          void skipSpace()
+          {
+            while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+              ++p;
+          }
+
+          bool consume(char c)
+          {
+            skipSpace();
+            if (p == end || *p != c)
+              return false;
+            ++p;
+            return true;
+          }
+
+          bool readLiteral(const char * word, int length)
+          {
+            if (end - p < length || qstrncmp(p, word, uint(length)) != 0)
+              return fail(QJsonParseError::IllegalValue);
+            p += length;
+            return true;
+          }
+
+          //p is on the opening brace
+          bool readObject(QVariantOrderedQMap & map, int depth)
+          {
+            if (depth > MaxDepth)
+              return fail(QJsonParseError::DeepNesting);
+            ++p;
+            if (consume('}'))
+              return true;
+            do
+            {
+              skipSpace();
+              if (p == end || *p != '"')
+                return fail(p == end ? QJsonParseError::UnterminatedObject : QJsonParseError::IllegalValue);
+              QString key;
+              if (!readString(key))
+                return false;
+              if (!consume(':'))
+                return fail(QJsonParseError::MissingNameSeparator);
+              QVariant value;
+              if (!readValue(value, depth))
+                return false;
+              map.insert(key, value);
+            } while (consume(','));
+            if (!consume('}'))
+              return fail(p == end ? QJsonParseError::UnterminatedObject : QJsonParseError::MissingValueSeparator);
+            return true;
+          }
+
+          //p is on the opening bracket
+          bool readArray(QVariantList & list, int depth)
+          {
+            if (depth > MaxDepth)
+              return fail(QJsonParseError::DeepNesting);
+            ++p;
+            if (consume(']'))
+              return true;
+            do
+            {
+              QVariant value;
+              if (!readValue(value, depth))
+                return false;
+              list.append(value);
+            } while (consume(','));
+            if (!consume(']'))
+              return fail(p == end ? QJsonParseError::UnterminatedArray : QJsonParseError::MissingValueSeparator);
+            return true;
+          }
+
+          bool readValue(QVariant & value, int depth)
+          {
+            skipSpace();
+            if (p == end)
+              return fail(QJsonParseError::IllegalValue);
+            switch (*p)
+            {
+              case '{':
+              {
+                QVariantOrderedQMap map;
+                if (!readObject(map, depth + 1))
+                  return false;
+                value = QVariant::fromValue(map);
+                return true;
+              }
+              case '[':
+              {
+                QVariantList list;
+                if (!readArray(list, depth + 1))
+                  return false;
+                value = list;
+                return true;
+              }
+              case '"':
+              {
+                QString str;
+                if (!readString(str))
+                  return false;
+                value = str;
+                return true;
+              }
+              case 't':
+                value = true;
+                return readLiteral("true", 4);
+              case 'f':
+                value = false;
+                return readLiteral("false", 5);
+              case 'n':
+                value = QVariant();
+                return readLiteral("null", 4);
+              default:
+                return readNumber(value);
+            }
+          }
+
+          bool readNumber(QVariant & value)
+          {
+            const char * start = p;
+            bool integral = true;
+            if (p != end && *p == '-')
+              ++p;
+            if (p == end || !isDigit(*p))
+              return fail(QJsonParseError::IllegalValue);
+            if (*p == '0')
+              ++p;
+            else
+              skipDigits();
+            if (p != end && *p == '.')
+            {
+              integral = false;
+              ++p;
+              if (p == end || !isDigit(*p))
+                return fail(QJsonParseError::IllegalNumber);
+              skipDigits();
+            }
+            if (p != end && (*p == 'e' || *p == 'E'))
+            {
+              integral = false;
+              ++p;
+              if (p != end && (*p == '+' || *p == '-'))
+                ++p;
+              if (p == end || !isDigit(*p))
+                return fail(QJsonParseError::IllegalNumber);
+              skipDigits();
+            }
+            const QByteArray number = QByteArray::fromRawData(start, int(p - start));
+            bool ok = false;
+            if (integral)
+            {
+              const qlonglong n = number.toLongLong(&ok);
+              if (ok)
+              {
+                if (n >= std::numeric_limits<int>::min() && n <= std::numeric_limits<int>::max())
+                  value = int(n);
+                else
+                  value = n;
+                return true;
+              }
+            }
+            value = number.toDouble(&ok);
+            return ok || fail(QJsonParseError::IllegalNumber);
+          }
+
+          static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+          void skipDigits()
+          {
+            while (p != end && isDigit(*p))
+              ++p;
+          }
+
+          static int hexValue(char c)
+          {
+            if (c >= '0' && c <= '9')
+              return c - '0';
+            if (c >= 'a' && c <= 'f')
+              return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+              return c - 'A' + 10;
+            return -1;
+          }
+
+          bool readHex4(uint & u)
+          {
+            if (end - p < 4)
+              return fail(QJsonParseError::IllegalEscapeSequence);
+            u = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+              const int h = hexValue(*p++);
+              if (h < 0)
+                return fail(QJsonParseError::IllegalEscapeSequence);
+              u = (u << 4) | uint(h);
+            }
+            return true;
+          }
+
+          //true for well-formed UTF-8: no overlong forms, surrogates or code points above U+10FFFF,
+          //which QString::fromUtf8() would silently replace
+          static bool isUtf8(const char * begin, const char * last)
+          {
+            const uchar * s = reinterpret_cast<const uchar *>(begin);
+            const uchar * e = reinterpret_cast<const uchar *>(last);
+            while (s != e)
+            {
+              const uchar c = *s++;
+              if (c < 0x80)
+                continue;
+              int n;
+              uint u;
+              uint min;
+              if ((c & 0xe0) == 0xc0)
+              {
+                n = 1;
+                u = c & 0x1f;
+                min = 0x80;
+              }
+              else if ((c & 0xf0) == 0xe0)
+              {
+                n = 2;
+                u = c & 0x0f;
+                min = 0x800;
+              }
+              else if ((c & 0xf8) == 0xf0)
+              {
+                n = 3;
+                u = c & 0x07;
+                min = 0x10000;
+              }
+              else
+                return false;
+              if (e - s < n)
+                return false;
+              for (; n > 0; --n, ++s)
+              {
+                if ((*s & 0xc0) != 0x80)
+                  return false;
+                u = (u << 6) | (*s & 0x3f);
+              }
+              if (u < min || u > 0x10ffff || (u >= 0xd800 && u <= 0xdfff))
+                return false;
+            }
+            return true;
+          }
+
+          //p is on the opening quote; runs without escapes are decoded in one go
+          bool readString(QString & str)
+          {
+            ++p;
+            const char * run = p;
+            for (;;)
+            {
+              if (p == end)
+                return fail(QJsonParseError::UnterminatedString);
+              const char c = *p;
+              //RFC 8259 only allows control characters escaped
+              if (uchar(c) < 0x20)
+                return fail(QJsonParseError::IllegalValue);
+              if (c != '"' && c != '\\')
+              {
+                ++p;
+                continue;
+              }
+              if (p != run)
+              {
+                if (!isUtf8(run, p))
+                  return fail(QJsonParseError::IllegalUTF8String);
+                str.append(QString::fromUtf8(run, int(p - run)));
+              }
+              ++p;
+              if (c == '"')
+                return true;
+              if (p == end)
+                return fail(QJsonParseError::UnterminatedString);
+              switch (*p++)
+              {
+                case '"': str.append(QLatin1Char('"')); break;
+                case '\\': str.append(QLatin1Char('\\')); break;
+                case '/': str.append(QLatin1Char('/')); break;
+                case 'b': str.append(QLatin1Char('\b')); break;
+                case 'f': str.append(QLatin1Char('\f')); break;
+                case 'n': str.append(QLatin1Char('\n')); break;
+                case 'r': str.append(QLatin1Char('\r')); break;
+                case 't': str.append(QLatin1Char('\t')); break;
+                case 'u':
+                {
+                  uint u = 0;
+                  if (!readHex4(u))
+                    return false;
+                  str.append(QChar(ushort(u)));
+                  break;
+                }
+                default:
+                  return fail(QJsonParseError::IllegalEscapeSequence);
+              }
+              run = p;
+            }
+          }
+        };
+    };
+
+}
+
 #endif // ORDEREDQMAP_H
@@ -0,0 +1,201 @@
+﻿#ifndef ORDEREDQMAPPARALLEL_H
+#define ORDEREDQMAPPARALLEL_H
+#include "OrderedQMap.h"
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+/**
+* \brief OrderedQMapParallel runs the bulk operations of an OrderedQMap on the threads of
+* QThreadPool::globalInstance()
+*
+* The values are first collected in insertion order in one serial pass over the QMap, which costs a
+* key index lookup for every key not inserted in ascending order (see OrderedQMap::orderedValues()).
+* The work on them is then split into ranges handed to QtConcurrent::blockingMap, and every result keeps the insertion order.
+* Maps smaller than MinParallelSize are processed on the calling thread.
+* The functions passed in are called from several threads at once and must not modify the map.
+* Needs the Qt Concurrent module (QT += concurrent), which is why it is not part of OrderedQMap.h.
+*
+* \code
+* QVector<double> scores = OrderedQMapParallel::mapValues(events, [](const QVariant & v) { return score(v); });
+* QVariantOrderedQMap errors = OrderedQMapParallel::filtered(events, [](const QString &, const QVariant & v) {
+*   return v.toMap().value("level") == "error";
+* });
+* OrderedQMapParallel::sortOrder(events, [](const QVariant & a, const QVariant & b) { return a.toInt() < b.toInt(); });
+* \endcode
+*/
+
+namespace ActionNet {
+
+    struct OrderedQMapParallel
+    {
+        enum { MinParallelSize = 4096 };
+
+        //copies of the values in insertion order
+        template <class Key, class T, class KeyPolicy>
+        static QVector<T> values(const OrderedQMap<Key,T,KeyPolicy> & map)
+        {
+          return mapValues(map, [](const T & v) { return v; });
+        }
+
+        //f(value) of every value in insertion order
+        template <class Key, class T, class KeyPolicy, class Function>
+        static QVector<typename std::decay<decltype(std::declval<Function &>()(std::declval<const T &>()))>::type>
+        mapValues(const OrderedQMap<Key,T,KeyPolicy> & map, Function f)
+        {
+          typedef typename std::decay<decltype(f(std::declval<const T &>()))>::type R;
+          const QVector<const T *> values = map.orderedValues();
+          QVector<R> res(values.size());
+          R * out = res.data();
+          forEachRange(values.size(), [&](const Range & r) {
+            for (int i = r.first; i < r.last; ++i)
+              out[i] = f(*values.at(i));
+          });
+          return res;
+        }
+
+        //replaces every value by f(value); the map detaches first if it is shared
+        template <class Key, class T, class KeyPolicy, class Function>
+        static void transformValues(OrderedQMap<Key,T,KeyPolicy> & map, Function f)
+        {
+          map.QMap<Key,T>::detach();
+          const QVector<const T *> values = map.orderedValues();
+          forEachRange(values.size(), [&](const Range & r) {
+            for (int i = r.first; i < r.last; ++i)
+              *const_cast<T *>(values.at(i)) = f(*values.at(i));
+          });
+        }
+
+        //the entries for which pred(key, value) holds, in insertion order.
+        //pred runs in parallel, the result is built on the calling thread
+        template <class Key, class T, class KeyPolicy, class Predicate>
+        static OrderedQMap<Key,T,KeyPolicy> filtered(const OrderedQMap<Key,T,KeyPolicy> & map, Predicate pred)
+        {
+          const QVector<const T *> values = map.orderedValues();
+          QVector<char> keep(values.size());
+          char * out = keep.data();
+          forEachRange(values.size(), [&](const Range & r) {
+            for (int i = r.first; i < r.last; ++i)
+              out[i] = pred(map.QList<Key>::at(i), *values.at(i)) ? 1 : 0;
+          });
+          OrderedQMap<Key,T,KeyPolicy> res;
+          res.reserve(int(std::count(keep.constBegin(), keep.constEnd(), char(1))));
+          for (int i = 0; i < values.size(); ++i)
+            if (keep.at(i))
+              res.insert(map.QList<Key>::at(i), *values.at(i));
+          return res;
+        }
+
+        //like OrderedQMap::sortOrder, stable, with a missing value sorted as T(); the ranges are sorted
+        //in parallel and then merged pairwise
+        template <class Key, class T, class KeyPolicy, class LessThan>
+        static void sortOrder(OrderedQMap<Key,T,KeyPolicy> & map, LessThan lessThan)
+        {
+          const QVector<const T *> values = map.orderedValues();
+          Q_ASSERT_X(!values.contains(nullptr), "OrderedQMapParallel::sortOrder", "key index out of sync with the map");
+          const T missing = T();
+          map.sortKeys(stableOrder(values.size(), [&](int a, int b) {
+            return lessThan(values.at(a) ? *values.at(a) : missing, values.at(b) ? *values.at(b) : missing);
+          }));
+        }
+
+        //like OrderedQMap::sortOrderByKey, stable
+        template <class Key, class T, class KeyPolicy, class LessThan>
+        static void sortOrderByKey(OrderedQMap<Key,T,KeyPolicy> & map, LessThan lessThan)
+        {
+          const QList<Key> & keys = map;
+          map.sortKeys(stableOrder(keys.size(), [&](int a, int b) { return lessThan(keys.at(a), keys.at(b)); }));
+        }
+
+    private:
+        struct Range
+        {
+          int first;
+          int last;
+        };
+
+        //[first, middle) and [middle, last) merged into one sorted range
+        struct Merge
+        {
+          int first;
+          int middle;
+          int last;
+        };
+
+        //consecutive ranges covering n items, four per thread, a single one for small n
+        static QVector<Range> ranges(int n)
+        {
+          QVector<Range> res;
+          const int threads = QThreadPool::globalInstance()->maxThreadCount();
+          if (n < MinParallelSize || threads < 2)
+          {
+            Range r = { 0, n };
+            res.append(r);
+            return res;
+          }
+          const int size = qMax(int(MinParallelSize) / 4, (n + threads * 4 - 1) / (threads * 4));
+          for (int first = 0; first < n; first += size)
+          {
+            Range r = { first, qMin(n, first + size) };
+            res.append(r);
+          }
+          return res;
+        }
+
+        template <class Task> static void forEachRange(int n, Task task)
+        {
+          QVector<Range> r = ranges(n);
+          if (r.size() == 1)
+            task(r.at(0));
+          else
+            QtConcurrent::blockingMap(r, task);
+        }
+
+        //the positions 0..n-1 stably sorted by less(int, int)
+        template <class Less> static QVector<int> stableOrder(int n, Less less)
+        {
+          QVector<int> order(n);
+          for (int i = 0; i < n; ++i)
+            order[i] = i;
+          QVector<Range> runs = ranges(n);
+          if (runs.size() == 1)
+          {
+            std::stable_sort(order.begin(), order.end(), less);
+            return order;
+          }
+          int * data = order.data();
+          QtConcurrent::blockingMap(runs, [&](const Range & r) { std::stable_sort(data + r.first, data + r.last, less); });
+
+          //std::merge takes from the left range on ties, so every level stays stable
+          QVector<int> buffer(n);
+          int * to = buffer.data();
+          while (runs.size() > 1)
+          {
+            QVector<Merge> merges;
+            QVector<Range> merged;
+            for (int i = 0; i < runs.size(); i += 2)
+            {
+              const bool pair = i + 1 < runs.size();
+              Merge m = { runs.at(i).first, runs.at(i).last, pair ? runs.at(i + 1).last : runs.at(i).last };
+              Range r = { m.first, m.last };
+              merges.append(m);
+              merged.append(r);
+            }
+            QtConcurrent::blockingMap(merges, [&](const Merge & m) {
+              std::merge(data + m.first, data + m.middle, data + m.middle, data + m.last, to + m.first, less);
+            });
+            std::swap(data, to);
+            runs.swap(merged);
+          }
+          if (data != order.data())
+            order.swap(buffer);
+          return order;
+        }
+    };
+
+}
+
+#endif // ORDEREDQMAPPARALLEL_H
@@ -0,0 +1,159 @@
+﻿#ifndef ORDEREDQMAPSNAPSHOT_H
+#define ORDEREDQMAPSNAPSHOT_H
+#include "OrderedQMap.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+/**
+* \brief template OrderedQMapPublisher and OrderedQMapSnapshot classes share an ordered map between threads
+* without locking the readers
+*
+* The publisher owns the current version of the map. Readers take a snapshot(), an immutable reference
+* counted handle to that version, and read it lock free for as long as they hold it. Writers build the next
+* version from a copy of the current one (cheap, the Qt containers inside are implicitly shared) and publish() it.
+* A snapshot taken before keeps seeing the complete old version, never the order of one version with the
+* values of another.
+* Works with OrderedQMap and CompactOrderedQMap.
+*
+* \code
+* OrderedQMapPublisher<QVariantOrderedQMap> config;
+*
+* //writer thread
+* config.update([](QVariantOrderedQMap & map) { map.insert("timeout", 30); });
+*
+* //reader threads
+* OrderedQMapSnapshot<QVariantOrderedQMap> snap = config.snapshot();
+* for(int i = 0; i < snap->size(); ++i){
+*   qDebug() << snap->key(i) << "=" << snap->at(i);
+* }
+* \endcode
+*/
+
+namespace ActionNet {
+
+    template <class Map> struct OrderedQMapSnapshotData
+    {
+        explicit OrderedQMapSnapshotData(const Map & m) : ref(1), map(m) {}
+
+        QAtomicInt ref;
+        const Map map;
+    };
+
+    //immutable version of a published map; copying it only touches one atomic reference count
+    template <class Map> class OrderedQMapSnapshot
+    {
+    public:
+        OrderedQMapSnapshot() : d(nullptr) {}
+
+        OrderedQMapSnapshot(const OrderedQMapSnapshot &o) : d(o.d) { if (d) d->ref.ref(); }
+
+        OrderedQMapSnapshot(OrderedQMapSnapshot &&o) : d(o.d) { o.d = nullptr; }
+
+        ~OrderedQMapSnapshot() { release(d); }
+
+        OrderedQMapSnapshot &operator=(OrderedQMapSnapshot o)
+        {
+          qSwap(d, o.d);
+          return *this;
+        }
+
+        bool isNull() const { return !d; }
+
+        //an empty map for a null snapshot
+        const Map &map() const
+        {
+          static const Map empty;
+          return d ? d->map : empty;
+        }
+
+        const Map &operator*() const { return map(); }
+
+        const Map *operator->() const { return &map(); }
+
+    private:
+        template <class> friend class OrderedQMapPublisher;
+        typedef OrderedQMapSnapshotData<Map> Data;
+
+        //adopts a reference that is already counted
+        explicit OrderedQMapSnapshot(Data *data) : d(data) {}
+
+        static void release(Data *data)
+        {
+          if (data && !data->ref.deref())
+            delete data;
+        }
+
+        Data *d;
+    };
+
+    //owns the current version of a map; snapshot() is lock and wait free, publish() and update() are
+    //serialized against each other
+    template <class Map> class OrderedQMapPublisher
+    {
+    public:
+        typedef OrderedQMapSnapshot<Map> Snapshot;
+
+        explicit OrderedQMapPublisher(const Map & map = Map()) : m_current(new Data(map)), m_acquiring(0) {}
+
+        //no snapshot() may run concurrently with the destructor; snapshots taken before stay valid
+        ~OrderedQMapPublisher()
+        {
+          Snapshot::release(m_current.loadAcquire());
+          for (Data * d : m_retired)
+            Snapshot::release(d);
+        }
+
+        Snapshot snapshot() const
+        {
+          m_acquiring.ref();
+          Data * d = m_current.loadAcquire();
+          d->ref.ref();
+          m_acquiring.deref();
+          return Snapshot(d);
+        }
+
+        //makes map the current version
+        void publish(const Map & map)
+        {
+          QMutexLocker locker(&m_writeLock);
+          publishLocked(map);
+        }
+
+        //applies f to a copy of the current version and publishes the result
+        template <class Function> void update(Function f)
+        {
+          QMutexLocker locker(&m_writeLock);
+          Map next = m_current.loadAcquire()->map;
+          f(next);
+          publishLocked(next);
+        }
+
+    private:
+        Q_DISABLE_COPY(OrderedQMapPublisher)
+        typedef OrderedQMapSnapshotData<Map> Data;
+
+        //the replaced version keeps the publisher's reference until no reader is between loading
+        //m_current and referencing what it loaded; it is retried on the next publish otherwise
+        void publishLocked(const Map & map)
+        {
+          m_retired.append(m_current.fetchAndStoreOrdered(new Data(map)));
+          //read-modify-write, so it is ordered against the readers' ref()/deref() of m_acquiring
+          if (m_acquiring.fetchAndAddOrdered(0) != 0)
+            return;
+          for (Data * d : m_retired)
+            Snapshot::release(d);
+          m_retired.clear();
+        }
+
+        QAtomicPointer<Data> m_current;
+        mutable QAtomicInt m_acquiring;
+        QMutex m_writeLock;
+        QVector<Data *> m_retired;
+    };
+
+}
+
+#endif // ORDEREDQMAPSNAPSHOT_H
@@ -0,0 +1,165 @@
+﻿#ifndef ORDEREDQMAPSTREAMREADER_H
+#define ORDEREDQMAPSTREAMREADER_H
+#include "OrderedQMap.h"
+#include <QDataStream>
+#include <QIODevice>
+
+/**
+* \brief template OrderedQMapStreamReader class decodes the QDataStream format of the ordered containers
+* one entry at a time, as the data arrives
+*
+* operator>> needs the whole stream at once and builds the complete map before returning. The reader
+* instead decodes from a device that may only hold part of the data yet, like a socket: readNext()
+* returns the next entry in insertion order when its bytes are complete and otherwise leaves the device
+* untouched until more data is available. Only one entry is held at a time, so the entries can be
+* processed or inserted into any of the ordered containers (readInto()) without a second copy of the
+* stream in memory.
+* Streams written before the format was versioned keep the order in a separate key list and cannot be
+* decoded incrementally; the reader stops in state LegacyFormat without consuming anything, buffer them
+* and use operator>> instead.
+*
+* \code
+* OrderedQMapStreamReader<QString, QVariant> reader(socket);
+* QVariantOrderedQMap map;
+*
+* connect(socket, &QTcpSocket::readyRead, [&]() {
+*   reader.readInto(map);
+*   if (reader.atEnd())
+*     qDebug() << "received" << map.size() << "entries";
+*   else if (reader.hasError())
+*     socket->abort();
+* });
+* \endcode
+*/
+
+namespace ActionNet {
+
+    template <class Key, class T> class OrderedQMapStreamReader
+    {
+    public:
+        enum State { ReadingHeader, ReadingEntries, Finished, LegacyFormat, Failed };
+
+        explicit OrderedQMapStreamReader(QIODevice * device = nullptr) : m_in(device) { reset(); }
+
+        //starts reading a new stream from device
+        void setDevice(QIODevice * device)
+        {
+          m_in.setDevice(device);
+          reset();
+        }
+
+        QIODevice *device() const { return m_in.device(); }
+
+        //the stream the values are decoded with; set its version and byte order before reading
+        QDataStream &stream() { return m_in; }
+
+        //decodes the next entry when all of its bytes are available.
+        //Returns false when more data is needed (the device is left as it was), after the last entry and
+        //once the stream turned out corrupt; state() tells them apart
+        bool readNext()
+        {
+          if (m_state == ReadingHeader && !readStreamHeader())
+            return false;
+          if (m_state != ReadingEntries)
+            return false;
+          m_in.startTransaction();
+          m_in >> m_key >> m_value;
+          if (!commit())
+            return false;
+          if (++m_read == m_count)
+            m_state = Finished;
+          return true;
+        }
+
+        //key and value of the entry decoded by the last successful readNext(); readInto() moves the value out
+        const Key &key() const { return m_key; }
+
+        const T &value() const { return m_value; }
+
+        //inserts every complete entry, at most maxEntries of them (all when negative), into map and returns
+        //how many were inserted. Works with every ordered container, including the multimaps.
+        //map grows as the entries arrive, so a corrupt count cannot make it allocate up front.
+        //The decoded value is moved into map, the next readNext() overwrites it anyway; the containers
+        //take the key by const reference and copy it
+        template <class Map> int readInto(Map & map, int maxEntries = -1)
+        {
+          int n = 0;
+          while ((maxEntries < 0 || n < maxEntries) && readNext())
+          {
+            map.insert(m_key, std::move(m_value));
+            ++n;
+          }
+          return n;
+        }
+
+        State state() const { return m_state; }
+
+        //true once the last entry has been read
+        bool atEnd() const { return m_state == Finished; }
+
+        bool hasError() const { return m_state == Failed || m_state == LegacyFormat; }
+
+        //ReadPastEnd while waiting for more data; a device that is closed in that state ended early
+        QDataStream::Status status() const { return m_in.status(); }
+
+        //number of entries in the stream, -1 until the header has been read
+        int count() const { return m_count; }
+
+        int entriesRead() const { return m_read; }
+
+    private:
+        Q_DISABLE_COPY(OrderedQMapStreamReader)
+
+        QDataStream m_in;
+        State m_state;
+        qint32 m_count;
+        qint32 m_read;
+        Key m_key;
+        T m_value;
+
+        void reset()
+        {
+          m_state = ReadingHeader;
+          m_count = -1;
+          m_read = 0;
+          m_key = Key();
+          m_value = T();
+        }
+
+        bool readStreamHeader()
+        {
+          if (!m_in.device())
+            return false;
+          qint32 count = 0;
+          bool legacy = false;
+          m_in.startTransaction();
+          OrderedQMapStream::readHeader(m_in, count, legacy);
+          if (legacy && m_in.status() == QDataStream::Ok)
+          {
+            //rewinds the device, so the caller can hand the whole stream to operator>>
+            m_in.rollbackTransaction();
+            m_in.resetStatus();
+            m_state = LegacyFormat;
+            return false;
+          }
+          if (!commit())
+            return false;
+          m_count = count;
+          m_state = count == 0 ? Finished : ReadingEntries;
+          return true;
+        }
+
+        //ends the transaction of the current read; a read past the end of the available data waits for more
+        bool commit()
+        {
+          if (m_in.commitTransaction())
+            return true;
+          if (m_in.status() != QDataStream::ReadPastEnd)
+            m_state = Failed;
+          return false;
+        }
+    };
+
+}
+
+#endif // ORDEREDQMAPSTREAMREADER_H
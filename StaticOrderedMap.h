@@ -0,0 +1,230 @@
+﻿#ifndef STATICORDEREDMAP_H
+#define STATICORDEREDMAP_H
+#include "OrderedQMap.h"
+#include <QLatin1String>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+/**
+* \brief template StaticOrderedMap class is an insertion ordered lookup table built at compile time
+*
+* The entries are stored in list order in a plain array next to an index of their positions sorted by
+* key, both filled by the constexpr constructor. A constexpr table is therefore part of the binary's
+* read-only data: nothing runs or allocates at startup, and keyOrder() is a binary search.
+* Key must be a literal type, typically an integer, an enum or const char * for string literals; a
+* const char * table can also be searched by QString, QStringView or QLatin1String, its keys are
+* compared as Latin-1. Keys must be unique, hasUniqueKeys() can check that in a static_assert.
+*
+* \code
+* static constexpr auto DayOfWeek = makeStaticOrderedMap<const char *, int>({
+*   {"Sunday", 1}, {"Monday", 2}, {"Tuesday", 3}, {"Wednesday", 4}, {"Thursday", 5}, {"Friday", 6}, {"Saturday", 7}
+* });
+* static_assert(DayOfWeek.hasUniqueKeys(), "duplicate day");
+* static_assert(DayOfWeek.value("Monday") == 2, "");
+*
+* int day = DayOfWeek.value(name, 0);   //name is a QString
+* for (auto it = DayOfWeek.constOrderedBegin(); it != DayOfWeek.constOrderedEnd(); ++it)
+*   qDebug() << it.key() << "=" << it.value();
+* \endcode
+*/
+
+namespace ActionNet {
+
+    template <class Key, class T> struct StaticOrderedMapEntry
+    {
+        Key key;
+        T value;
+    };
+
+    //key comparison of StaticOrderedMap, negative, zero or positive like strcmp
+    template <class Key> struct StaticOrderedMapKeys
+    {
+        static constexpr int compare(const Key & a, const Key & b) { return a < b ? -1 : (b < a ? 1 : 0); }
+    };
+
+    template <> struct StaticOrderedMapKeys<const char *>
+    {
+        static constexpr int compare(const char * a, const char * b)
+        {
+          while (*a && *a == *b)
+          {
+            ++a;
+            ++b;
+          }
+          return int(uchar(*a)) - int(uchar(*b));
+        }
+
+        static int compare(const char * a, QStringView b)
+        {
+          for (int i = 0; i < b.size(); ++i, ++a)
+          {
+            if (!*a)
+              return -1;
+            if (int(uchar(*a)) != int(b.at(i).unicode()))
+              return int(uchar(*a)) - int(b.at(i).unicode());
+          }
+          return *a ? 1 : 0;
+        }
+
+        static int compare(const char * a, const QString & b) { return compare(a, QStringView(b)); }
+
+        static int compare(const char * a, QLatin1String b)
+        {
+          for (int i = 0; i < b.size(); ++i, ++a)
+          {
+            if (!*a)
+              return -1;
+            if (*a != b.data()[i])
+              return int(uchar(*a)) - int(uchar(b.data()[i]));
+          }
+          return *a ? 1 : 0;
+        }
+    };
+
+    template <class Key, class T, int N> class StaticOrderedMap
+    {
+        static_assert(N > 0, "StaticOrderedMap needs at least one entry");
+
+    public:
+        typedef StaticOrderedMapEntry<Key, T> Entry;
+        typedef StaticOrderedMapKeys<Key> Keys;
+
+        //iterates in insertion order; operator* gives the value and key() the key
+        class const_ordered_iterator
+        {
+        public:
+            constexpr const_ordered_iterator() : e(nullptr) {}
+
+            constexpr const Key &key() const { return e->key; }
+
+            constexpr const T &value() const { return e->value; }
+
+            constexpr const T &operator*() const { return e->value; }
+
+            constexpr const T *operator->() const { return &e->value; }
+
+            constexpr bool operator==(const const_ordered_iterator &o) const { return e == o.e; }
+
+            constexpr bool operator!=(const const_ordered_iterator &o) const { return e != o.e; }
+
+            const_ordered_iterator &operator++()
+            {
+              ++e;
+              return *this;
+            }
+
+            const_ordered_iterator operator++(int)
+            {
+              const_ordered_iterator r = *this;
+              ++e;
+              return r;
+            }
+
+        private:
+            friend class StaticOrderedMap;
+            constexpr explicit const_ordered_iterator(const Entry * entry) : e(entry) {}
+
+            const Entry * e;
+        };
+
+        //entries in insertion order; the index is sorted with an insertion sort, which the compiler runs
+        //for a constexpr table
+        constexpr StaticOrderedMap(const Entry (&entries)[N]) : m_entries(), m_sorted()
+        {
+          for (int i = 0; i < N; ++i)
+          {
+            m_entries[i] = entries[i];
+            int j = i;
+            for (; j > 0 && Keys::compare(m_entries[m_sorted[j - 1]].key, entries[i].key) > 0; --j)
+              m_sorted[j] = m_sorted[j - 1];
+            m_sorted[j] = i;
+          }
+        }
+
+        constexpr int size() const { return N; }
+
+        constexpr int count() const { return N; }
+
+        constexpr bool isEmpty() const { return false; }
+
+        //the key and the value at index, which must be valid
+        constexpr const Key &key(int index) const { return m_entries[index].key; }
+
+        constexpr const T &at(int index) const { return m_entries[index].value; }
+
+        //position of key in insertion order or -1; O(log N)
+        template <class K> constexpr int keyOrder(const K & key) const
+        {
+          int first = 0;
+          int last = N;
+          while (first < last)
+          {
+            const int middle = first + (last - first) / 2;
+            const int c = Keys::compare(m_entries[m_sorted[middle]].key, key);
+            if (c == 0)
+              return m_sorted[middle];
+            if (c < 0)
+              first = middle + 1;
+            else
+              last = middle;
+          }
+          return -1;
+        }
+
+        template <class K> constexpr bool contains(const K & key) const { return keyOrder(key) >= 0; }
+
+        template <class K> constexpr T value(const K & key, const T & defaultValue = T()) const
+        {
+          const int i = keyOrder(key);
+          return i < 0 ? defaultValue : m_entries[i].value;
+        }
+
+        constexpr bool hasUniqueKeys() const
+        {
+          for (int i = 1; i < N; ++i)
+            if (Keys::compare(m_entries[m_sorted[i - 1]].key, m_entries[m_sorted[i]].key) == 0)
+              return false;
+          return true;
+        }
+
+        QList<Key> keys() const
+        {
+          QList<Key> res;
+          res.reserve(N);
+          for (const Entry & e : m_entries)
+            res.append(e.key);
+          return res;
+        }
+
+        QList<T> values() const
+        {
+          QList<T> res;
+          res.reserve(N);
+          for (const Entry & e : m_entries)
+            res.append(e.value);
+          return res;
+        }
+
+        constexpr const_ordered_iterator constOrderedBegin() const { return const_ordered_iterator(m_entries); }
+
+        constexpr const_ordered_iterator constOrderedEnd() const { return const_ordered_iterator(m_entries + N); }
+
+        OrderedQMapRange<const_ordered_iterator> ordered() const
+        { return OrderedQMapRange<const_ordered_iterator>(constOrderedBegin(), constOrderedEnd()); }
+
+    private:
+        Entry m_entries[N];
+        int m_sorted[N];    //positions in m_entries, ascending by key
+    };
+
+    //deduces N from the braced list, e.g. makeStaticOrderedMap<int, const char *>({{1, "one"}, {2, "two"}})
+    template <class Key, class T, int N>
+    constexpr StaticOrderedMap<Key, T, N> makeStaticOrderedMap(const StaticOrderedMapEntry<Key, T> (&entries)[N])
+    {
+      return StaticOrderedMap<Key, T, N>(entries);
+    }
+
+}
+
+#endif // STATICORDEREDMAP_H
@@ -0,0 +1,401 @@
+﻿#ifndef VERSIONEDORDEREDQMAP_H
+#define VERSIONEDORDEREDQMAP_H
+#include "OrderedQMap.h"
+#include <QDataStream>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <algorithm>
+
+/**
+* \brief template VersionedOrderedQMap class is an ordered map that records its changes, so replicas
+* can be kept up to date with deltas instead of the whole map
+*
+* Every change made through it increments version() and is kept in a bounded history. writeDelta()
+* writes the changes since a version a replica reported, applyDelta() replays them on the replica.
+* The history only holds keys and positions: a delta takes the current values when it is written,
+* so a key written many times is sent with its last value only, and consecutive writes of one key take
+* a single history entry. Sorting the order records the new key list, which is shared with the map
+* until the next change detaches it.
+* A replica that is too far behind, or got a delta that does not fit its state, gets a full copy
+* written with operator<<, which carries the version as well.
+* Works with OrderedQMap and OrderedQHash; read the map through map(), the non-const operator[]
+* records a change even when the value is only read.
+*
+* \code
+* VersionedOrderedQMap<QVariantOrderedQMap> state;
+* state.insert("timeout", 30);
+* state["retries"] = 3;
+*
+* //leader, for a follower that has version followerVersion
+* if (!state.writeDelta(out, followerVersion))
+*   out << state;
+*
+* //follower
+* if (!replica.applyDelta(in))
+*   requestFullCopy(replica.version());
+* \endcode
+*/
+
+namespace ActionNet {
+
+    template <class Map> class VersionedOrderedQMap
+    {
+    public:
+        typedef typename Map::key_type Key;
+        typedef typename Map::mapped_type T;
+
+        enum : quint8 { DeltaVersion = 1 };
+
+        //map is version 0
+        explicit VersionedOrderedQMap(const Map & map = Map()) : m_map(map), m_version(0), m_oldestVersion(0), m_historyLimit(4096) {}
+
+        const Map &map() const { return m_map; }
+
+        const Map *operator->() const { return &m_map; }
+
+        //incremented by every recorded change
+        quint64 version() const { return m_version; }
+
+        //deltas can be written for replicas with this version or newer
+        quint64 oldestVersion() const { return m_oldestVersion; }
+
+        //number of changes kept for writeDelta(); older ones are dropped as new ones are recorded
+        void setHistoryLimit(int changes)
+        {
+          m_historyLimit = qMax(0, changes);
+          trimHistory();
+        }
+
+        int historyLimit() const { return m_historyLimit; }
+
+        //drops the changes every replica has already applied
+        void discardHistory(quint64 upToVersion)
+        {
+          while (!m_changes.isEmpty() && m_changes.first().version <= upToVersion)
+            m_oldestVersion = m_changes.takeFirst().version;
+        }
+
+        void insert(const Key & key, const T & value)
+        {
+          const Op op = m_map.contains(key) ? Update : Insert;
+          m_map.insert(key, value);
+          record(op, key);
+        }
+
+        void prepend(const Key & key, const T & value)
+        {
+          const Op op = m_map.contains(key) ? Update : Prepend;
+          m_map.prepend(key, value);
+          record(op, key);
+        }
+
+        //records a write of key, the value is read when a delta is written
+        T &operator[](const Key & key)
+        {
+          record(m_map.contains(key) ? Update : Insert, key);
+          return m_map[key];
+        }
+
+        Key replaceAt(int index, const T & value)
+        {
+          Key key = m_map.replaceAt(index, value);
+          record(Update, key);
+          return key;
+        }
+
+        int remove(const Key & key)
+        {
+          int i = m_map.remove(key);
+          if (i >= 0)
+            record(Remove, key);
+          return i;
+        }
+
+        Key removeAt(int i)
+        {
+          Key key = m_map.removeAt(i);
+          record(Remove, key);
+          return key;
+        }
+
+        void clear()
+        {
+          m_map.clear();
+          record(Clear, Key());
+        }
+
+        void move(int from, int to)
+        {
+          if (from == to)
+            return;
+          m_map.move(from, to);
+          record(Move, Key(), from, to);
+        }
+
+        void swapAt(int i, int j)
+        {
+          if (i == j)
+            return;
+          m_map.swapAt(i, j);
+          record(Swap, Key(), i, j);
+        }
+
+        bool moveToFront(const Key & key)
+        {
+          int i = m_map.keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, 0);
+          return true;
+        }
+
+        bool moveToBack(const Key & key)
+        {
+          int i = m_map.keyOrder(key);
+          if (i < 0)
+            return false;
+          move(i, m_map.size() - 1);
+          return true;
+        }
+
+        template <class LessThan> void sortOrder(LessThan lessThan)
+        {
+          m_map.sortOrder(lessThan);
+          recordOrder();
+        }
+
+        template <class LessThan> void sortOrderByKey(LessThan lessThan)
+        {
+          m_map.sortOrderByKey(lessThan);
+          recordOrder();
+        }
+
+        //writes the changes from version since to version(); false, and nothing is written, when since is
+        //older than oldestVersion() or newer than version()
+        bool writeDelta(QDataStream & out, quint64 since) const
+        {
+          if (since < m_oldestVersion || since > m_version)
+            return false;
+          typename QList<Change>::const_iterator first = std::upper_bound(m_changes.constBegin(), m_changes.constEnd(), since,
+            [](quint64 v, const Change & c) { return v < c.version; });
+          out << quint8(DeltaVersion) << since << m_version << qint32(m_changes.constEnd() - first);
+          for (typename QList<Change>::const_iterator it = first; it != m_changes.constEnd(); ++it)
+          {
+            out << quint8(it->op);
+            switch (it->op)
+            {
+            case Insert:
+            case Prepend:
+            case Update:
+              out << it->key << m_map.value(it->key, T());
+              break;
+            case Remove:
+              out << it->key;
+              break;
+            case Move:
+            case Swap:
+              out << qint32(it->from) << qint32(it->to);
+              break;
+            case Reorder:
+              out << it->order;
+              break;
+            case Clear:
+              break;
+            }
+          }
+          return true;
+        }
+
+        //applies a delta written by writeDelta() for version(); afterwards version() is the version of the
+        //writer. The changes are applied to a copy that replaces the map only when all of them fit, so on
+        //false the map and version() are unchanged: the delta was corrupt, for another version, or did not
+        //fit the entries, in which case the map needs a full copy
+        bool applyDelta(QDataStream & in)
+        {
+          quint8 format = 0;
+          quint64 from = 0, to = 0;
+          qint32 count = 0;
+          in >> format >> from >> to >> count;
+          if (in.status() == QDataStream::Ok && (format > DeltaVersion || count < 0 || to < from))
+            in.setStatus(QDataStream::ReadCorruptData);
+          if (in.status() != QDataStream::Ok || from != m_version)
+            return false;
+
+          //decodes everything first, so a truncated delta changes nothing
+          QVector<Change> changes;
+          changes.reserve(OrderedQMapStream::reservation(count));
+          for (qint32 i = 0; i < count; ++i)
+          {
+            Change c;
+            quint8 op = 0;
+            in >> op;
+            c.op = Op(op);
+            switch (c.op)
+            {
+            case Insert:
+            case Prepend:
+            case Update:
+              in >> c.key >> c.value;
+              break;
+            case Remove:
+              in >> c.key;
+              break;
+            case Move:
+            case Swap:
+              in >> c.from >> c.to;
+              break;
+            case Reorder:
+              in >> c.order;
+              break;
+            case Clear:
+              break;
+            default:
+              in.setStatus(QDataStream::ReadCorruptData);
+            }
+            if (in.status() != QDataStream::Ok)
+              return false;
+            changes.append(c);
+          }
+
+          //shares the data with m_map until the first change detaches it
+          Map next = m_map;
+          for (const Change & c : changes)
+            if (!apply(next, c))
+              return false;
+          m_map.swap(next);
+          m_changes.clear();
+          m_version = m_oldestVersion = to;
+          return true;
+        }
+
+        //full copy: the version followed by the map
+        friend QDataStream &operator <<(QDataStream &out, const VersionedOrderedQMap &obj)
+        {
+          return out << obj.m_version << obj.m_map;
+        }
+
+        //replaces the map and its version, the history starts over
+        friend QDataStream &operator >>(QDataStream &in, VersionedOrderedQMap &obj)
+        {
+          quint64 version = 0;
+          Map map;
+          in >> version >> map;
+          if (in.status() != QDataStream::Ok)
+            return in;
+          obj.m_map.swap(map);
+          obj.m_changes.clear();
+          obj.m_version = obj.m_oldestVersion = version;
+          return in;
+        }
+
+    private:
+        enum Op : quint8 { Insert, Prepend, Update, Remove, Move, Swap, Reorder, Clear };
+
+        struct Change
+        {
+          quint64 version = 0;
+          Op op = Clear;
+          Key key = Key();
+          qint32 from = 0;
+          qint32 to = 0;
+          QList<Key> order;   //key order after a sort
+          T value = T();      //only set while applying a delta
+        };
+
+        Map m_map;
+        quint64 m_version;
+        quint64 m_oldestVersion;
+        int m_historyLimit;
+        QList<Change> m_changes;
+
+        void record(Op op, const Key & key, int from = 0, int to = 0)
+        {
+          ++m_version;
+          //a delta sends the current value anyway, so a write right after another one of the same key
+          //only moves that entry to the new version; replaying it on a replica that has it is harmless
+          if (op == Update && !m_changes.isEmpty())
+          {
+            Change & last = m_changes.last();
+            if (last.op <= Update && last.key == key)
+            {
+              last.version = m_version;
+              return;
+            }
+          }
+          Change c;
+          c.version = m_version;
+          c.op = op;
+          c.key = key;
+          c.from = from;
+          c.to = to;
+          m_changes.append(c);
+          trimHistory();
+        }
+
+        void recordOrder()
+        {
+          record(Reorder, Key());
+          m_changes.last().order = m_map.keys();
+        }
+
+        void trimHistory()
+        {
+          while (m_changes.size() > m_historyLimit)
+            m_oldestVersion = m_changes.takeFirst().version;
+          if (m_changes.isEmpty())
+            m_oldestVersion = m_version;
+        }
+
+        static bool apply(Map & map, const Change & c)
+        {
+          const int n = map.size();
+          switch (c.op)
+          {
+          case Insert:
+            map.insert(c.key, c.value);
+            return true;
+          case Prepend:
+            map.prepend(c.key, c.value);
+            return true;
+          case Update:
+            if (!map.contains(c.key))
+              return false;
+            map.insert(c.key, c.value);
+            return true;
+          case Remove:
+            return map.remove(c.key) >= 0;
+          case Move:
+          case Swap:
+            if (c.from < 0 || c.from >= n || c.to < 0 || c.to >= n)
+              return false;
+            if (c.op == Move)
+              map.move(c.from, c.to);
+            else
+              map.swapAt(c.from, c.to);
+            return true;
+          case Reorder:
+          {
+            if (c.order.size() != n)
+              return false;
+            QHash<Key, int> rank;
+            rank.reserve(n);
+            for (int i = 0; i < n; ++i)
+              if (!map.contains(c.order.at(i)) || rank.contains(c.order.at(i)))
+                return false;
+              else
+                rank.insert(c.order.at(i), i);
+            map.sortOrderByKey([&rank](const Key & a, const Key & b) { return rank.value(a) < rank.value(b); });
+            return true;
+          }
+          case Clear:
+            map.clear();
+            return true;
+          }
+          return false;
+        }
+    };
+
+}
+
+#endif // VERSIONEDORDEREDQMAP_H
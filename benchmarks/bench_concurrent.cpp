@@ -0,0 +1,116 @@
+﻿#include "ConcurrentOrderedQMap.h"
+#include "OrderedQMap.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QVector>
+#include <QtTest>
+#include <thread>
+#include <vector>
+
+using namespace ActionNet;
+
+/**
+* \brief scaling of ConcurrentOrderedQMap with the number of writer threads
+*
+* Every row inserts the same number of distinct keys, split evenly over 1 to 16 threads; the keys are
+* built before the measurement. The single mutex around an OrderedQMap is the baseline the striped map
+* replaces, so the two tests have the same rows and their times can be compared row by row.
+*/
+class ConcurrentBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void stripedInsert_data() { threadRows(); }
+    void stripedInsert();
+
+    void mutexInsert_data() { threadRows(); }
+    void mutexInsert();
+
+    void stripedInsertAndRead_data() { threadRows(); }
+    void stripedInsertAndRead();
+
+private:
+    enum { Keys = 200000 };
+
+    QVector<QString> m_keys;
+
+    static void threadRows()
+    {
+      QTest::addColumn<int>("threads");
+      for (int threads : { 1, 2, 4, 8, 16 })
+        QTest::newRow(qPrintable(QString("%1 threads").arg(threads))) << threads;
+    }
+
+    //runs f(first, last) on threads threads, each getting an equal share of the keys
+    template <class Function> void split(int threads, Function f) const
+    {
+      std::vector<std::thread> workers;
+      const int share = (m_keys.size() + threads - 1) / threads;
+      for (int t = 0; t < threads; ++t)
+        workers.emplace_back([=]() { f(t * share, qMin(m_keys.size(), (t + 1) * share)); });
+      for (std::thread & w : workers)
+        w.join();
+    }
+};
+
+void ConcurrentBenchmark::initTestCase()
+{
+  m_keys.reserve(Keys);
+  for (int i = 0; i < Keys; ++i)
+    m_keys.append(QString("event-%1").arg(i));
+}
+
+void ConcurrentBenchmark::stripedInsert()
+{
+  QFETCH(int, threads);
+  QBENCHMARK {
+    ConcurrentOrderedQMap<QString, int> map;
+    split(threads, [&](int first, int last) {
+      for (int i = first; i < last; ++i)
+        map.insert(m_keys.at(i), i);
+    });
+    QCOMPARE(map.size(), int(Keys));
+  }
+}
+
+void ConcurrentBenchmark::mutexInsert()
+{
+  QFETCH(int, threads);
+  QBENCHMARK {
+    OrderedQMap<QString, int> map;
+    QMutex lock;
+    split(threads, [&](int first, int last) {
+      for (int i = first; i < last; ++i)
+      {
+        QMutexLocker locker(&lock);
+        map.insert(m_keys.at(i), i);
+      }
+    });
+    QCOMPARE(map.size(), int(Keys));
+  }
+}
+
+//every writer reads back each key it inserted, so half of the operations take the read lock
+void ConcurrentBenchmark::stripedInsertAndRead()
+{
+  QFETCH(int, threads);
+  QBENCHMARK {
+    ConcurrentOrderedQMap<QString, int> map;
+    split(threads, [&](int first, int last) {
+      for (int i = first; i < last; ++i)
+      {
+        map.insert(m_keys.at(i), i);
+        map.value(m_keys.at(i));
+      }
+    });
+    QCOMPARE(map.size(), int(Keys));
+  }
+}
+
+QTEST_MAIN(ConcurrentBenchmark)
+
+#include "bench_concurrent.moc"
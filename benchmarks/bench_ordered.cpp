@@ -0,0 +1,421 @@
+﻿#include "OrderedQHash.h"
+#include "OrderedQMap.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <QtTest>
+#include <type_traits>
+
+using namespace ActionNet;
+
+/**
+* \brief the hot paths of the ordered containers against QMap and QHash
+*
+* Every test has one row per container, value type (int, QString, QVariant) and size (10 to 1M keys);
+* the keys are QStrings built before the measurement. Operations QMap and QHash do not have (at(),
+* keyOrder(), the case insensitive contains()) only have rows for the ordered containers, removeAt(0)
+* is compared with erasing QMap's and QHash's first entry. CompactOrderedQMap runs once in its default
+* ImmediateRemoval mode and once in LazyRemoval mode, contains(key, Qt::CaseInsensitive) also with
+* CaseInsensitiveKeys.
+* Lookups and scans time a pass over the whole map, remove and removeAt(0) change the map and are timed
+* once on a fresh one, for RemoveCount keys.
+* valueAtPath() reads "<key>/leaf" through a nested QVariantOrderedQMap per key, from an OrderedQMap with
+* the default policy and with StringViewKeys, up to MaxPathSize keys.
+*/
+class OrderedBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void insert_data() { rows(AllContainers); }
+    void insert();
+
+    void subscript_data() { rows(AllContainers); }
+    void subscript();
+
+    void at_data() { rows(OrderedContainers); }
+    void at();
+
+    void remove_data() { rows(AllContainers); }
+    void remove();
+
+    void removeFirst_data() { rows(AllContainers); }
+    void removeFirst();
+
+    void keyOrder_data() { rows(OrderedContainers); }
+    void keyOrder();
+
+    void values_data() { rows(AllContainers); }
+    void values();
+
+    void containsCaseInsensitive_data() { rows(OrderedContainers | FoldedContainers); }
+    void containsCaseInsensitive();
+
+    void streamRoundTrip_data() { rows(AllContainers); }
+    void streamRoundTrip();
+
+    void valueAtPath_data();
+    void valueAtPath();
+
+private:
+    enum Container
+    {
+        QMapContainer, QHashContainer, OrderedQMapContainer, OrderedQHashContainer, CompactContainer, LazyCompactContainer,
+        FoldedOrderedQMapContainer, FoldedOrderedQHashContainer, FoldedCompactContainer, ContainerCount
+    };
+
+    enum ContainerSet
+    {
+        QtContainers = 0x3, OrderedContainers = 0x3c, FoldedContainers = 0x1c0, AllContainers = QtContainers | OrderedContainers
+    };
+
+    enum Payload { IntPayload, StringPayload, VariantPayload };
+
+    enum { MaxSize = 1000000, MaxPathSize = 100000, RemoveCount = 1000, CaseInsensitiveLookups = 100 };
+
+    QVector<QString> m_keys;
+    QVector<QString> m_upperKeys;   //m_keys in upper case, for the case insensitive lookups
+
+    template <class M, class V> struct Type
+    {
+        typedef M type;
+        typedef V value;
+    };
+
+    template <class Map> struct IsOrdered : std::true_type {};
+    template <class K, class T> struct IsOrdered<QMap<K, T> > : std::false_type {};
+    template <class K, class T> struct IsOrdered<QHash<K, T> > : std::false_type {};
+
+    static void rows(int containers)
+    {
+      static const char * const containerNames[ContainerCount] = {
+        "QMap", "QHash", "OrderedQMap", "OrderedQHash", "CompactOrderedQMap", "CompactOrderedQMap LazyRemoval",
+        "OrderedQMap CaseInsensitiveKeys", "OrderedQHash CaseInsensitiveKeys", "CompactOrderedQMap CaseInsensitiveKeys"
+      };
+      static const char * const payloadNames[] = { "int", "QString", "QVariant" };
+      QTest::addColumn<int>("container");
+      QTest::addColumn<int>("payload");
+      QTest::addColumn<int>("size");
+      for (int c = 0; c < ContainerCount; ++c)
+        if (containers & (1 << c))
+          for (int p = IntPayload; p <= VariantPayload; ++p)
+            for (int size = 10; size <= MaxSize; size *= 10)
+              QTest::newRow(qPrintable(QString("%1 %2 %3").arg(containerNames[c]).arg(payloadNames[p]).arg(size)))
+                << c << p << size;
+    }
+
+    //calls f(Type<Map, T>(), container, size) with the map and value types of the current row;
+    //f gets the container to tell the CompactOrderedQMap removal modes apart
+    template <class Function> static void dispatch(Function f)
+    {
+      QFETCH(int, payload);
+      switch (payload)
+      {
+      case IntPayload:
+        dispatchContainer<int>(f);
+        break;
+      case StringPayload:
+        dispatchContainer<QString>(f);
+        break;
+      case VariantPayload:
+        dispatchContainer<QVariant>(f);
+        break;
+      }
+    }
+
+    template <class T, class Function> static void dispatchContainer(Function f)
+    {
+      QFETCH(int, container);
+      QFETCH(int, size);
+      switch (container)
+      {
+      case QMapContainer:
+        f(Type<QMap<QString, T>, T>(), container, size);
+        break;
+      case QHashContainer:
+        f(Type<QHash<QString, T>, T>(), container, size);
+        break;
+      case OrderedQMapContainer:
+        f(Type<OrderedQMap<QString, T>, T>(), container, size);
+        break;
+      case OrderedQHashContainer:
+        f(Type<OrderedQHash<QString, T>, T>(), container, size);
+        break;
+      case CompactContainer:
+      case LazyCompactContainer:
+        f(Type<CompactOrderedQMap<QString, T>, T>(), container, size);
+        break;
+      case FoldedOrderedQMapContainer:
+        f(Type<OrderedQMap<QString, T, CaseInsensitiveKeys>, T>(), container, size);
+        break;
+      case FoldedOrderedQHashContainer:
+        f(Type<OrderedQHash<QString, T, CaseInsensitiveKeys>, T>(), container, size);
+        break;
+      case FoldedCompactContainer:
+        f(Type<CompactOrderedQMap<QString, T, CaseInsensitiveKeys>, T>(), container, size);
+        break;
+      }
+    }
+
+    template <class T> static T payloadValue(int i);
+
+    template <class Map> static void prepare(Map & map, int container)
+    {
+      if (container == LazyCompactContainer)
+        prepareLazy(map);
+    }
+
+    template <class Map> static void prepareLazy(Map &) {}
+
+    template <class T, class KeyPolicy, class Allocation>
+    static void prepareLazy(CompactOrderedQMap<QString, T, KeyPolicy, Allocation> & map)
+    {
+      map.setRemovalMode(CompactOrderedQMap<QString, T, KeyPolicy, Allocation>::LazyRemoval);
+    }
+
+    template <class Map, class T> Map build(int container, int size) const
+    {
+      Map map;
+      prepare(map, container);
+      for (int i = 0; i < size; ++i)
+        map.insert(m_keys.at(i), payloadValue<T>(i));
+      return map;
+    }
+
+    //a pass of valueAtPath() over size paths of two segments each
+    template <class Map> void pathLookups(int size) const
+    {
+      Map map;
+      QVector<QString> paths;
+      paths.reserve(size);
+      for (int i = 0; i < size; ++i)
+      {
+        QVariantOrderedQMap nested;
+        nested.insert(QStringLiteral("leaf"), i);
+        map.insert(m_keys.at(i), QVariant::fromValue(nested));
+        paths.append(m_keys.at(i) + QLatin1String("/leaf"));
+      }
+      QCOMPARE(map.valueAtPath(paths.last()).toInt(), size - 1);
+      qint64 sum = 0;
+      QBENCHMARK {
+        for (int i = 0; i < size; ++i)
+          sum += map.valueAtPath(paths.at(i)).toInt();
+      }
+      QVERIFY(sum >= 0);
+    }
+
+    static const void * volatile s_sink;
+
+    //keeps the compiler from dropping a read
+    template <class T> static void use(const T & value) { s_sink = &value; }
+};
+
+const void * volatile OrderedBenchmark::s_sink = nullptr;
+
+template <> int OrderedBenchmark::payloadValue<int>(int i) { return i; }
+
+template <> QString OrderedBenchmark::payloadValue<QString>(int i) { return QString::number(i); }
+
+template <> QVariant OrderedBenchmark::payloadValue<QVariant>(int i) { return QVariant(i); }
+
+void OrderedBenchmark::initTestCase()
+{
+  m_keys.reserve(MaxSize);
+  m_upperKeys.reserve(MaxSize);
+  for (int i = 0; i < MaxSize; ++i)
+  {
+    m_keys.append(QString("key-%1").arg(i));
+    m_upperKeys.append(m_keys.last().toUpper());
+  }
+}
+
+void OrderedBenchmark::insert()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    QBENCHMARK {
+      Map map;
+      prepare(map, container);
+      for (int i = 0; i < size; ++i)
+        map.insert(m_keys.at(i), payloadValue<T>(i));
+      QCOMPARE(map.size(), size);
+    }
+  });
+}
+
+//operator[] of keys that are in the map
+void OrderedBenchmark::subscript()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    Map map = build<Map, T>(container, size);
+    QBENCHMARK {
+      for (int i = 0; i < size; ++i)
+        use(map[m_keys.at(i)]);
+    }
+    QCOMPARE(map.size(), size);
+  });
+}
+
+void OrderedBenchmark::at()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    if constexpr (IsOrdered<Map>::value)
+    {
+      const Map map = build<Map, T>(container, size);
+      QBENCHMARK {
+        for (int i = 0; i < size; ++i)
+          use(map.at(i));
+      }
+    }
+  });
+}
+
+//removes RemoveCount keys spread evenly over the insertion order
+void OrderedBenchmark::remove()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    Map map = build<Map, T>(container, size);
+    const int count = qMin(size, int(RemoveCount));
+    QBENCHMARK_ONCE {
+      for (int i = 0; i < count; ++i)
+        map.remove(m_keys.at(int(qint64(i) * size / count)));
+    }
+    QCOMPARE(map.size(), size - count);
+  });
+}
+
+//removeAt(0) RemoveCount times; QMap and QHash erase their first entry instead
+void OrderedBenchmark::removeFirst()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    Map map = build<Map, T>(container, size);
+    const int count = qMin(size, int(RemoveCount));
+    QBENCHMARK_ONCE {
+      for (int i = 0; i < count; ++i)
+      {
+        if constexpr (IsOrdered<Map>::value)
+          map.removeAt(0);
+        else
+          map.erase(map.begin());
+      }
+    }
+    QCOMPARE(map.size(), size - count);
+  });
+}
+
+void OrderedBenchmark::keyOrder()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    if constexpr (IsOrdered<Map>::value)
+    {
+      const Map map = build<Map, T>(container, size);
+      qint64 sum = 0;
+      QBENCHMARK {
+        for (int i = 0; i < size; ++i)
+          sum += map.keyOrder(m_keys.at(i));
+      }
+      QVERIFY(sum >= 0);
+    }
+  });
+}
+
+void OrderedBenchmark::values()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    const Map map = build<Map, T>(container, size);
+    QBENCHMARK {
+      const QList<T> values = map.values();
+      QCOMPARE(values.size(), size);
+    }
+  });
+}
+
+//CaseInsensitiveLookups lookups of upper case keys, spread over the map; a scan of the map each
+//without CaseInsensitiveKeys
+void OrderedBenchmark::containsCaseInsensitive()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    if constexpr (IsOrdered<Map>::value)
+    {
+      const Map map = build<Map, T>(container, size);
+      const int count = qMin(size, int(CaseInsensitiveLookups));
+      QBENCHMARK {
+        for (int i = 0; i < count; ++i)
+          QVERIFY(map.contains(m_upperKeys.at(int(qint64(i) * size / count)), Qt::CaseInsensitive));
+      }
+      //keeps value(key, Qt::CaseInsensitive) compiling on a non-const map, where CompactOrderedQMap
+      //also has its touching value() overloads
+      Map mutableMap = map;
+      QCOMPARE(mutableMap.value(m_upperKeys.at(0), Qt::CaseInsensitive), payloadValue<T>(0));
+    }
+  });
+}
+
+//writes the map to a QByteArray and reads it back
+void OrderedBenchmark::streamRoundTrip()
+{
+  dispatch([this](auto type, int container, int size) {
+    typedef typename decltype(type)::type Map;
+    typedef typename decltype(type)::value T;
+    const Map map = build<Map, T>(container, size);
+    QBENCHMARK {
+      QByteArray data;
+      {
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << map;
+      }
+      QDataStream in(data);
+      Map read;
+      in >> read;
+      QCOMPARE(read.size(), size);
+    }
+  });
+}
+
+void OrderedBenchmark::valueAtPath_data()
+{
+  QTest::addColumn<int>("container");
+  QTest::addColumn<int>("size");
+  for (int size = 10; size <= MaxPathSize; size *= 10)
+  {
+    QTest::newRow(qPrintable(QString("OrderedQMap QVariant %1").arg(size))) << int(OrderedQMapContainer) << size;
+    QTest::newRow(qPrintable(QString("OrderedQMap StringViewKeys QVariant %1").arg(size))) << int(FoldedOrderedQMapContainer) << size;
+  }
+}
+
+//also keeps findAtPath() compiling for a map whose policy has no metatype of its own
+void OrderedBenchmark::valueAtPath()
+{
+  QFETCH(int, container);
+  QFETCH(int, size);
+  if (container == OrderedQMapContainer)
+    pathLookups<QVariantOrderedQMap>(size);
+  else
+    pathLookups<OrderedQMap<QString, QVariant, StringViewKeys> >(size);
+}
+
+QTEST_MAIN(OrderedBenchmark)
+
+#include "bench_ordered.moc"
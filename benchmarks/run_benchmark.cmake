@@ -0,0 +1,22 @@
+# Runs one benchmark and stores its results as
+#   RESULTS_DIR/NAME/<UTC date>-<commit>.csv
+# so runs of different revisions can be compared file by file.
+# Called by the <name>_results targets with BENCHMARK, NAME, RESULTS_DIR and SOURCE_DIR set.
+
+string(TIMESTAMP stamp "%Y%m%d-%H%M%S" UTC)
+execute_process(COMMAND git rev-parse --short HEAD
+                WORKING_DIRECTORY ${SOURCE_DIR}
+                OUTPUT_VARIABLE commit
+                OUTPUT_STRIP_TRAILING_WHITESPACE
+                ERROR_QUIET)
+if(NOT commit)
+  set(commit unknown)
+endif()
+
+file(MAKE_DIRECTORY ${RESULTS_DIR}/${NAME})
+set(out ${RESULTS_DIR}/${NAME}/${stamp}-${commit}.csv)
+execute_process(COMMAND ${BENCHMARK} -o ${out},csv -o -,txt RESULT_VARIABLE failed)
+if(failed)
+  message(FATAL_ERROR "${NAME} failed")
+endif()
+message(STATUS "results written to ${out}")